@@ -0,0 +1,42 @@
+# Training run of the PGO build (see PLANNER_PGO in CMakeLists.txt), run with
+# cmake -P. Replays every corpus log with the instrumented replay tool, then
+# copies the resulting .gcda files next to the objects of the optimised
+# planner_core, where gcc -fprofile-use looks for them.
+#
+# Expects REPLAY, CORPUS_DIR, MAP_DIR, INSTRUMENTED_OBJECTS, OPTIMISED_OBJECTS
+# and STAMP to be defined.
+
+file(GLOB_RECURSE stale_profiles "${INSTRUMENTED_OBJECTS}/*.gcda")
+if(stale_profiles)
+  file(REMOVE ${stale_profiles})
+endif()
+
+file(GLOB corpus "${CORPUS_DIR}/*.pplog")
+if(NOT corpus)
+  message(FATAL_ERROR "No telemetry logs in ${CORPUS_DIR}")
+endif()
+
+foreach(log ${corpus})
+  # Logs are named after the map they were recorded on.
+  get_filename_component(map_name "${log}" NAME_WE)
+  message(STATUS "PGO training: ${map_name}")
+  execute_process(
+    COMMAND "${REPLAY}" --map "${MAP_DIR}/${map_name}.csv" --repeat 20 "${log}"
+    RESULT_VARIABLE result
+    OUTPUT_QUIET)
+  # 1 only means the planner no longer reproduces the recorded paths, which
+  # doesn't matter for training.
+  if(NOT result EQUAL 0 AND NOT result EQUAL 1)
+    message(FATAL_ERROR "Replaying ${log} failed: ${result}")
+  endif()
+endforeach()
+
+file(GLOB_RECURSE profiles RELATIVE "${INSTRUMENTED_OBJECTS}" "${INSTRUMENTED_OBJECTS}/*.gcda")
+if(NOT profiles)
+  message(FATAL_ERROR "The training run left no profiles in ${INSTRUMENTED_OBJECTS}")
+endif()
+foreach(profile ${profiles})
+  get_filename_component(dir "${OPTIMISED_OBJECTS}/${profile}" DIRECTORY)
+  file(COPY "${INSTRUMENTED_OBJECTS}/${profile}" DESTINATION "${dir}")
+endforeach()
+file(WRITE "${STAMP}" "")
@@ -0,0 +1,302 @@
+#include "alloc_counter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "counter.h"
+#ifdef __linux__
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef PLANNER_ALLOC_TRACKING
+
+namespace
+{
+	enum NameState
+	{
+		UNNAMED,
+		NAMING,
+		NAMED
+	};
+
+	struct ThreadAllocations
+	{
+		atomic<bool> claimed;
+		atomic<int> name_state;
+		char name[32];
+		SingleWriterCounter allocations;
+		SingleWriterCounter deallocations;
+		SingleWriterCounter bytes_allocated;
+		SingleWriterCounter unexpected_allocations;
+		char padding[64];
+	};
+
+	// operator new can't allocate its own bookkeeping, so threads claim
+	// slots out of a static array; slots are never released, which keeps
+	// totals from going down when threads exit. Threads beyond the array
+	// share the last slot, whose counts may then lose updates.
+	const int MAX_THREADS = 256;
+	ThreadAllocations slots[MAX_THREADS];
+	atomic<int> slots_claimed(0);
+
+	// Nesting depth of armed NoAllocationScopes on this thread.
+	thread_local int no_allocation_depth = 0;
+
+	ThreadAllocations &threadSlot()
+	{
+		// A plain pointer is constant-initialised, so touching it never
+		// allocates (a dynamically initialised thread_local might).
+		static thread_local ThreadAllocations *slot = nullptr;
+		if (!slot)
+		{
+			int index = slots_claimed.fetch_add(1);
+			slot = &slots[index < MAX_THREADS ? index : MAX_THREADS - 1];
+			slot->claimed.store(true);
+		}
+		return *slot;
+	}
+
+	void *countedAllocate(size_t size)
+	{
+		void *p = malloc(size ? size : 1);
+		if (!p)
+		{
+			throw bad_alloc();
+		}
+		ThreadAllocations &slot = threadSlot();
+		slot.allocations.add();
+		slot.bytes_allocated.add(size);
+		if (no_allocation_depth)
+		{
+			slot.unexpected_allocations.add();
+		}
+		return p;
+	}
+
+	void countedFree(void *p)
+	{
+		if (p)
+		{
+			threadSlot().deallocations.add();
+			free(p);
+		}
+	}
+
+	AllocationCounts slotCounts(const ThreadAllocations &slot)
+	{
+		AllocationCounts counts;
+		counts.allocations = slot.allocations.load();
+		counts.deallocations = slot.deallocations.load();
+		counts.bytes_allocated = slot.bytes_allocated.load();
+		counts.unexpected_allocations = slot.unexpected_allocations.load();
+		return counts;
+	}
+}
+
+bool allocationTrackingEnabled()
+{
+	return true;
+}
+
+AllocationCounts allocationCounts()
+{
+	AllocationCounts counts = {0, 0, 0, 0};
+	for (int i = 0; i < MAX_THREADS; i++)
+	{
+		if (slots[i].claimed.load())
+		{
+			AllocationCounts slot = slotCounts(slots[i]);
+			counts.allocations += slot.allocations;
+			counts.deallocations += slot.deallocations;
+			counts.bytes_allocated += slot.bytes_allocated;
+			counts.unexpected_allocations += slot.unexpected_allocations;
+		}
+	}
+	return counts;
+}
+
+AllocationCounts threadAllocationCounts()
+{
+	return slotCounts(threadSlot());
+}
+
+void setAllocationThreadName(const char *name)
+{
+	ThreadAllocations &slot = threadSlot();
+	int unnamed = UNNAMED;
+	if (slot.name_state.compare_exchange_strong(unnamed, NAMING))
+	{
+		strncpy(slot.name, name, sizeof(slot.name) - 1);
+		slot.name_state.store(NAMED, memory_order_release);
+	}
+}
+
+void forEachThreadAllocations(const function<void(const char *name, const AllocationCounts &)> &visit)
+{
+	for (int i = 0; i < MAX_THREADS; i++)
+	{
+		if (slots[i].claimed.load())
+		{
+			bool named = slots[i].name_state.load(memory_order_acquire) == NAMED;
+			visit(named ? slots[i].name : "", slotCounts(slots[i]));
+		}
+	}
+}
+
+NoAllocationScope::NoAllocationScope(bool armed)
+	: armed_(armed), start_(threadSlot().unexpected_allocations.load())
+{
+	if (armed_)
+	{
+		no_allocation_depth++;
+	}
+}
+
+NoAllocationScope::~NoAllocationScope()
+{
+	if (armed_)
+	{
+		no_allocation_depth--;
+	}
+}
+
+uint64_t NoAllocationScope::unexpectedAllocations() const
+{
+	return threadSlot().unexpected_allocations.load() - start_;
+}
+
+void *operator new(size_t size)
+{
+	return countedAllocate(size);
+}
+
+void *operator new[](size_t size)
+{
+	return countedAllocate(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+	try
+	{
+		return countedAllocate(size);
+	}
+	catch (const bad_alloc &)
+	{
+		return nullptr;
+	}
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept
+{
+	try
+	{
+		return countedAllocate(size);
+	}
+	catch (const bad_alloc &)
+	{
+		return nullptr;
+	}
+}
+
+void operator delete(void *p) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete(void *p, const nothrow_t &) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete[](void *p, const nothrow_t &) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	countedFree(p);
+}
+
+#else
+
+bool allocationTrackingEnabled()
+{
+	return false;
+}
+
+AllocationCounts allocationCounts()
+{
+	AllocationCounts counts = {0, 0, 0, 0};
+	return counts;
+}
+
+AllocationCounts threadAllocationCounts()
+{
+	return allocationCounts();
+}
+
+void setAllocationThreadName(const char *)
+{
+}
+
+void forEachThreadAllocations(const function<void(const char *name, const AllocationCounts &)> &)
+{
+}
+
+NoAllocationScope::NoAllocationScope(bool armed) : armed_(armed), start_(0)
+{
+}
+
+NoAllocationScope::~NoAllocationScope()
+{
+}
+
+uint64_t NoAllocationScope::unexpectedAllocations() const
+{
+	return 0;
+}
+
+#endif // PLANNER_ALLOC_TRACKING
+
+MemoryFootprint processMemory()
+{
+	MemoryFootprint footprint = {0, 0};
+#ifdef __linux__
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm)
+	{
+		unsigned long size = 0;
+		unsigned long resident = 0;
+		if (fscanf(statm, "%lu %lu", &size, &resident) == 2)
+		{
+			footprint.resident_bytes = (uint64_t)resident * sysconf(_SC_PAGESIZE);
+		}
+		fclose(statm);
+	}
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		footprint.peak_resident_bytes = (uint64_t)usage.ru_maxrss * 1024;  // kB on Linux
+	}
+	// The two are sampled differently; keep them consistent.
+	footprint.peak_resident_bytes = max(footprint.peak_resident_bytes, footprint.resident_bytes);
+#endif
+	return footprint;
+}
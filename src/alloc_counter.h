@@ -0,0 +1,67 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+#include <functional>
+
+// Heap allocation totals. With PLANNER_ALLOC_TRACKING (the default, cmake
+// -DPLANNER_ALLOC_TRACKING=OFF leaves it out) alloc_counter.cpp replaces the
+// global operator new/delete with versions that count into a slot of the
+// calling thread (relaxed single-writer updates, no locks). Without it all
+// counts read as zero and the scopes below do nothing.
+struct AllocationCounts
+{
+	uint64_t allocations;
+	uint64_t deallocations;
+	uint64_t bytes_allocated;
+	uint64_t unexpected_allocations;  // made inside a NoAllocationScope
+};
+
+bool allocationTrackingEnabled();
+
+// Sums the slots of all threads.
+AllocationCounts allocationCounts();
+
+// Totals of the calling thread so far; cheap enough to take around every
+// planning stage, which is how stages and sessions get their share.
+AllocationCounts threadAllocationCounts();
+
+// Names the calling thread's slot for forEachThreadAllocations(); only the
+// first name given sticks.
+void setAllocationThreadName(const char *name);
+
+// Visits the slot of every thread that ever allocated (threads beyond the
+// slot array share the last one).
+void forEachThreadAllocations(const std::function<void(const char *name, const AllocationCounts &)> &visit);
+
+// Marks code that must not touch the heap, such as a planning cycle once
+// its buffers have grown to size. Allocations the calling thread makes
+// while an armed scope is alive are counted as unexpected; callers check
+// unexpectedAllocations() (or the total) to assert that it stays zero.
+class NoAllocationScope
+{
+public:
+	explicit NoAllocationScope(bool armed = true);
+	~NoAllocationScope();
+	NoAllocationScope(const NoAllocationScope &) = delete;
+	NoAllocationScope &operator=(const NoAllocationScope &) = delete;
+
+	// Unexpected allocations of the calling thread since this scope began.
+	uint64_t unexpectedAllocations() const;
+
+private:
+	bool armed_;
+	uint64_t start_;
+};
+
+// Resident set size of the process, now and at its peak (0 where the
+// platform doesn't tell). Available with or without allocation tracking.
+struct MemoryFootprint
+{
+	uint64_t resident_bytes;
+	uint64_t peak_resident_bytes;
+};
+
+MemoryFootprint processMemory();
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,70 @@
+#include "arena.h"
+#include <algorithm>
+
+using namespace std;
+
+Arena::Arena(size_t capacity)
+	: block_(static_cast<char *>(::operator new(capacity))), capacity_(capacity), used_(0), overflow_used_(0)
+{
+}
+
+Arena::~Arena()
+{
+	for (const Overflow &o : overflow_)
+	{
+		::operator delete(o.block);
+	}
+	::operator delete(block_);
+}
+
+void *Arena::allocateOverflow(size_t size, size_t alignment)
+{
+	// Alignments never exceed that of max_align_t, which operator new
+	// already guarantees for the start of a block.
+	size_t block_size = max(size, capacity_);
+	if (!overflow_.empty())
+	{
+		Overflow &last = overflow_.back();
+		size_t offset = (overflow_used_ + alignment - 1) & ~(alignment - 1);
+		if (offset + size <= last.size)
+		{
+			overflow_used_ = offset + size;
+			return last.block + offset;
+		}
+	}
+	overflow_.push_back(Overflow{static_cast<char *>(::operator new(block_size)), block_size});
+	overflow_used_ = size;
+	return overflow_.back().block;
+}
+
+bool Arena::ownsOverflow(const char *p) const
+{
+	for (const Overflow &o : overflow_)
+	{
+		if (p >= o.block && p < o.block + o.size)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void Arena::reset()
+{
+	used_ = 0;
+	if (overflow_.empty())
+	{
+		return;
+	}
+	size_t needed = capacity_;
+	for (const Overflow &o : overflow_)
+	{
+		needed += o.size;
+		::operator delete(o.block);
+	}
+	overflow_.clear();
+	overflow_used_ = 0;
+	::operator delete(block_);
+	block_ = static_cast<char *>(::operator new(needed));
+	capacity_ = needed;
+}
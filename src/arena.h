@@ -0,0 +1,150 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Monotonic bump allocator for memory that only lives for one planning cycle.
+// Allocation is a pointer bump, freeing is a no-op and reset() forgets
+// everything at once. Not thread safe; each session owns one and only the
+// worker planning that session touches it.
+class Arena
+{
+public:
+	static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+	explicit Arena(size_t capacity = DEFAULT_CAPACITY);
+	~Arena();
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	void *allocate(size_t size, size_t alignment)
+	{
+		size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+		if (offset + size > capacity_)
+		{
+			return allocateOverflow(size, alignment);
+		}
+		used_ = offset + size;
+		return block_ + offset;
+	}
+
+	// Forgets everything allocated since the last reset. A cycle that
+	// overflowed the block grows it to fit the whole cycle, so a steady
+	// workload stops touching the heap after its first cycles.
+	void reset();
+
+	bool owns(const void *p) const
+	{
+		const char *c = static_cast<const char *>(p);
+		if (c >= block_ && c < block_ + capacity_)
+		{
+			return true;
+		}
+		return !overflow_.empty() && ownsOverflow(c);
+	}
+
+	size_t capacity() const { return capacity_; }
+
+private:
+	void *allocateOverflow(size_t size, size_t alignment);
+	bool ownsOverflow(const char *p) const;
+
+	struct Overflow
+	{
+		char *block;
+		size_t size;
+	};
+
+	char *block_;
+	size_t capacity_;
+	size_t used_;
+	// Blocks taken from the heap this cycle after 'block_' ran out.
+	std::vector<Overflow> overflow_;
+	size_t overflow_used_;
+};
+
+// The arena ArenaAllocator allocates from on the calling thread, or null for
+// the heap. A plain pointer is constant-initialised, so reading it never
+// allocates.
+inline Arena *&currentArena()
+{
+	static thread_local Arena *arena = nullptr;
+	return arena;
+}
+
+// Makes 'arena' the calling thread's current arena for the scope.
+class ArenaScope
+{
+public:
+	explicit ArenaScope(Arena &arena) : previous_(currentArena()) { currentArena() = &arena; }
+	~ArenaScope() { currentArena() = previous_; }
+	ArenaScope(const ArenaScope &) = delete;
+	ArenaScope &operator=(const ArenaScope &) = delete;
+
+private:
+	Arena *previous_;
+};
+
+// Stateless standard allocator over the current arena, falling back to the
+// heap outside of an ArenaScope. Containers using it must be destroyed
+// inside the scope they were filled in (and before the arena is reset).
+template <typename T>
+struct ArenaAllocator
+{
+	typedef T value_type;
+
+	ArenaAllocator() {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U> &) {}
+
+	T *allocate(size_t n)
+	{
+		Arena *arena = currentArena();
+		if (arena)
+		{
+			return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+		}
+		return static_cast<T *>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T *p, size_t)
+	{
+		Arena *arena = currentArena();
+		if (arena && arena->owns(p))
+		{
+			return;
+		}
+		::operator delete(p);
+	}
+
+	// Called directly by some containers (nlohmann::json among them).
+	template <typename U, typename... Args>
+	void construct(U *p, Args &&... args)
+	{
+		::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+	}
+
+	template <typename U>
+	void destroy(U *p)
+	{
+		p->~U();
+	}
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &, const ArenaAllocator<U> &)
+{
+	return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &, const ArenaAllocator<U> &)
+{
+	return false;
+}
+
+#endif // ARENA_H
@@ -0,0 +1,217 @@
+#include "behavior_planner.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+	// Bumper to bumper, centre to centre (m).
+	const double CAR_LENGTH = 5;
+	// Gap ahead (and behind) at which proximityCost() is down to 1/e (m).
+	const double FOLLOW_DISTANCE = 15;
+	const double CUT_IN_DISTANCE = 7.5;
+}
+
+double collisionCost(const BehaviorContext &context, const Maneuver &, const Rollout &rollout)
+{
+	if (context.collisions && context.collisions->steps() >= rollout.steps)
+	{
+		return context.collisions->firstCollision(rollout.s, rollout.d, rollout.steps, context.s,
+			context.lanes->center(context.lane)) >= 0 ? 1 : 0;
+	}
+	if (context.occupancy && context.occupancy->steps() >= rollout.steps)
+	{
+		for (int k = 0; k < rollout.steps; k++)
+		{
+			if (context.occupancy->collides(k, rollout.s[k], rollout.d[k]))
+			{
+				return 1;
+			}
+		}
+		return 0;
+	}
+	for (int k = 0; k < rollout.steps; k++)
+	{
+		if (rollout.gap_ahead[k] < CAR_LENGTH || rollout.gap_behind[k] < CAR_LENGTH)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+double proximityCost(const BehaviorContext &, const Maneuver &, const Rollout &rollout)
+{
+	double cost = 0;
+	for (int k = 0; k < rollout.steps; k++)
+	{
+		cost = max(cost, exp(-rollout.gap_ahead[k] / FOLLOW_DISTANCE));
+		cost = max(cost, exp(-rollout.gap_behind[k] / CUT_IN_DISTANCE));
+	}
+	return cost;
+}
+
+double efficiencyCost(const BehaviorContext &context, const Maneuver &, const Rollout &rollout)
+{
+	if (rollout.steps == 0 || context.speed_limit <= 0)
+	{
+		return 0;
+	}
+	double sum = 0;
+	for (int k = 0; k < rollout.steps; k++)
+	{
+		sum += rollout.speed[k];
+	}
+	return max(0.0, 1 - sum / rollout.steps / context.speed_limit);
+}
+
+double laneChangeCost(const BehaviorContext &context, const Maneuver &maneuver, const Rollout &)
+{
+	return maneuver.lane != context.lane ? 1 : 0;
+}
+
+vector<CostTerm> defaultCostTerms()
+{
+	return {
+		{"collision", collisionCost, 1000},
+		{"proximity", proximityCost, 20},
+		{"efficiency", efficiencyCost, 10},
+		{"lane_change", laneChangeCost, 1},
+	};
+}
+
+BehaviorPlanner::BehaviorPlanner(const BehaviorOptions &options, const vector<CostTerm> &costs)
+	: options_(options), costs_(costs), parallel_(options.threads)
+{
+	options_.steps = max(1, min(options_.steps, (int)Rollout::MAX_STEPS));
+	options_.speed_steps = max(2, min(options_.speed_steps, (int)MAX_SPEED_STEPS));
+}
+
+int BehaviorPlanner::generate(const BehaviorContext &context, Maneuver *candidates) const
+{
+	const VehicleTable &vehicles = *context.vehicles;
+	const LaneModel &lanes = *context.lanes;
+	// Own lane first, so that it wins a tie.
+	int lane_choices[3] = {context.lane, context.lane - 1, context.lane + 1};
+	int choices = context.may_change_lane ? 3 : 1;
+	int n = 0;
+	for (int c = 0; c < choices; c++)
+	{
+		int lane = lane_choices[c];
+		if (lane < 0 || lane >= lanes.count)
+		{
+			continue;
+		}
+		for (int k = 0; k < options_.speed_steps; k++)
+		{
+			candidates[n++] = Maneuver{lane, context.speed_limit * (options_.speed_steps - 1 - k) / (options_.speed_steps - 1)};
+		}
+		// Following that lane's leader
+		double leader_gap = INFINITY;
+		double leader_speed = 0;
+		for (size_t i = 0; i < vehicles.size(); i++)
+		{
+			double gap = vehicles.predicted_s[i] - context.s;
+			if (gap > 0 && gap < leader_gap && lanes.laneOf(vehicles.d[i]) == lane)
+			{
+				leader_gap = gap;
+				leader_speed = vehicles.speed[i];
+			}
+		}
+		if (leader_gap < INFINITY && leader_speed < context.speed_limit)
+		{
+			candidates[n++] = Maneuver{lane, leader_speed};
+		}
+	}
+	return n;
+}
+
+void BehaviorPlanner::rollout(const BehaviorContext &context, const Maneuver &maneuver, Rollout &out) const
+{
+	const VehicleTable &vehicles = *context.vehicles;
+	const LaneModel &lanes = *context.lanes;
+	const double band = lanes.width / 2 + 0.5;
+	const double d_from = lanes.center(context.lane);
+	const double d_to = lanes.center(maneuver.lane);
+	const double dv = options_.acceleration * (options_.horizon / options_.steps);
+	const PredictionBuffer *prediction = context.prediction && context.prediction->steps >= options_.steps ? context.prediction : nullptr;
+
+	out.steps = options_.steps;
+	out.dt = options_.horizon / options_.steps;
+	double s = context.s;
+	double v = context.speed;
+	for (int k = 0; k < out.steps; k++)
+	{
+		double t = (k + 1) * out.dt;
+		v = v < maneuver.speed ? min(maneuver.speed, v + dv) : max(maneuver.speed, v - dv);
+		s += v * out.dt;
+		double d = d_from + (d_to - d_from) * min(1.0, t / options_.lane_change_time);
+		out.s[k] = s;
+		out.d[k] = d;
+		out.speed[k] = v;
+
+		double ahead = INFINITY;
+		double behind = INFINITY;
+		for (size_t i = 0; i < vehicles.size(); i++)
+		{
+			double other_d = prediction ? prediction->d(k, i) : vehicles.d[i];
+			if (fabs(other_d - d) >= band)
+			{
+				continue;
+			}
+			double other_s = prediction ? prediction->s(k, i) : vehicles.predicted_s[i] + vehicles.speed[i] * t;
+			double gap = other_s - s;
+			if (gap >= 0)
+			{
+				ahead = min(ahead, gap);
+			}
+			else if (lanes.laneOf(vehicles.d[i]) != context.lane)
+			{
+				behind = min(behind, -gap);
+			}
+		}
+		out.gap_ahead[k] = ahead;
+		out.gap_behind[k] = behind;
+	}
+}
+
+double BehaviorPlanner::evaluate(const BehaviorContext &context, const Maneuver &maneuver) const
+{
+	Rollout played;
+	rollout(context, maneuver, played);
+	double cost = 0;
+	for (const CostTerm &term : costs_)
+	{
+		cost += term.weight * term.cost(context, maneuver, played);
+	}
+	return cost;
+}
+
+Maneuver BehaviorPlanner::choose(const BehaviorContext &context) const
+{
+	Maneuver candidates[MAX_CANDIDATES];
+	double costs[MAX_CANDIDATES];
+	int n = generate(context, candidates);
+	if (n == 0)
+	{
+		return Maneuver{context.lane, 0};
+	}
+
+	parallel_.run(n, options_.grain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			costs[i] = evaluate(context, candidates[i]);
+		}
+	});
+
+	int best = 0;
+	for (int i = 1; i < n; i++)
+	{
+		if (costs[i] < costs[best])
+		{
+			best = i;
+		}
+	}
+	return candidates[best];
+}
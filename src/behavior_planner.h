@@ -0,0 +1,143 @@
+#ifndef BEHAVIOR_PLANNER_H
+#define BEHAVIOR_PLANNER_H
+
+#include <cstddef>
+#include <vector>
+#include "lane_occupancy.h"
+#include "occupancy_grid.h"
+#include "parallel_for.h"
+#include "prediction.h"
+#include "swept_collision.h"
+#include "vehicle_table.h"
+
+// What the behaviour planner decides every cycle: the lane to be in and the
+// speed to drive at.
+struct Maneuver
+{
+	int lane;
+	double speed;  // m/s
+};
+
+// The inputs of one decision. Positions are those at the end of the
+// previous path, where the new path continues from.
+struct BehaviorContext
+{
+	const VehicleTable *vehicles;  // predicted_s filled in
+	const LaneModel *lanes;
+	int lane;
+	double s;
+	double speed;        // m/s
+	double speed_limit;  // m/s
+	bool may_change_lane;
+	// Where the other cars will be at the rollout steps (same steps and dt
+	// as the planner's options); without it they keep their speed and d.
+	const PredictionBuffer *prediction;
+	// The same predictions for collisionCost(), as exact boxes or
+	// rasterised; with neither, the rollout's gaps are used.
+	const SweptCollisionChecker *collisions;
+	const OccupancyGrid *occupancy;
+};
+
+// A candidate manoeuvre played forward over the horizon at fixed steps: the
+// car's own motion, and the nearest other cars it shares its lateral band
+// with at every step.
+struct Rollout
+{
+	static const int MAX_STEPS = 32;
+
+	int steps;
+	double dt;  // s
+	double s[MAX_STEPS];
+	double d[MAX_STEPS];
+	double speed[MAX_STEPS];
+	// Distance to the nearest car ahead and behind, INFINITY for none. Only
+	// cars outside the car's starting lane count behind: those already
+	// following it are its followers' business.
+	double gap_ahead[MAX_STEPS];
+	double gap_behind[MAX_STEPS];
+};
+
+// One term of a candidate's cost; the planner picks the candidate with the
+// lowest weighted sum of all terms. Terms are called concurrently and must
+// not keep state.
+typedef double (*CostFunction)(const BehaviorContext &context, const Maneuver &maneuver, const Rollout &rollout);
+
+struct CostTerm
+{
+	const char *name;
+	CostFunction cost;
+	double weight;
+};
+
+// The default terms.
+// 1 if the car would touch another one during the rollout: the swept box
+// test, or else a lookup in the occupancy grid per step, when the context
+// has one.
+double collisionCost(const BehaviorContext &context, const Maneuver &maneuver, const Rollout &rollout);
+// Rises from 0 towards 1 as the nearest gap ahead (or behind, after
+// cutting in) shrinks.
+double proximityCost(const BehaviorContext &context, const Maneuver &maneuver, const Rollout &rollout);
+// Fraction of the speed limit given up over the rollout.
+double efficiencyCost(const BehaviorContext &context, const Maneuver &maneuver, const Rollout &rollout);
+// 1 for changing lanes, so that only a real gain makes the car leave its lane.
+double laneChangeCost(const BehaviorContext &context, const Maneuver &maneuver, const Rollout &rollout);
+
+std::vector<CostTerm> defaultCostTerms();
+
+// What followBehavior() gives collisionCost() to check the rollouts with.
+enum CollisionCheck
+{
+	// Oriented boxes swept between the steps (see swept_collision.h).
+	COLLISION_SWEPT,
+	// Lanes by 1 m of road (see occupancy_grid.h): cheaper, but coarse.
+	COLLISION_GRID
+};
+
+struct BehaviorOptions
+{
+	double horizon = 4;             // s
+	int steps = 20;                 // rollout steps over the horizon
+	int speed_steps = 6;            // target speeds from the limit down to 0
+	double acceleration = 3;        // m/s^2, in the rollouts
+	double lane_change_time = 2.5;  // s
+	size_t threads = 0;             // helper threads for the evaluation
+	size_t grain = 4;               // candidates per chunk
+	CollisionCheck collisions = COLLISION_SWEPT;
+};
+
+// Cost-function behaviour planner: generates candidate manoeuvres (keep the
+// lane or move to a neighbouring one, each at a grid of target speeds plus
+// the speed of that lane's leader), rolls every candidate out and scores it
+// with the cost terms. Candidates are evaluated data-parallel on a
+// ParallelFor; choose() may be called from several threads at once.
+class BehaviorPlanner
+{
+public:
+	static const int MAX_SPEED_STEPS = 16;
+	// Three lanes, each at the grid speeds plus the leader's speed.
+	static const int MAX_CANDIDATES = 3 * (MAX_SPEED_STEPS + 1);
+
+	explicit BehaviorPlanner(const BehaviorOptions &options = BehaviorOptions(), const std::vector<CostTerm> &costs = defaultCostTerms());
+
+	const BehaviorOptions &options() const { return options_; }
+	const std::vector<CostTerm> &costs() const { return costs_; }
+
+	// The cheapest candidate for 'context'.
+	Maneuver choose(const BehaviorContext &context) const;
+
+	// Plays 'maneuver' forward from 'context'.
+	void rollout(const BehaviorContext &context, const Maneuver &maneuver, Rollout &out) const;
+
+	// Weighted sum of the cost terms for 'maneuver'.
+	double evaluate(const BehaviorContext &context, const Maneuver &maneuver) const;
+
+private:
+	// Fills 'candidates' and returns their number.
+	int generate(const BehaviorContext &context, Maneuver *candidates) const;
+
+	BehaviorOptions options_;
+	std::vector<CostTerm> costs_;
+	mutable ParallelFor parallel_;
+};
+
+#endif // BEHAVIOR_PLANNER_H
@@ -0,0 +1,35 @@
+#ifndef COUNTER_H
+#define COUNTER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Counter written by exactly one thread and read by any. Updates are a
+// relaxed load and store, no locked read-modify-write, so keeping one per
+// thread costs the hot path next to nothing; readers sum them up.
+class SingleWriterCounter
+{
+public:
+	SingleWriterCounter() : value_(0) {}
+
+	void add(uint64_t n = 1)
+	{
+		value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	// Raises the value to 'v' if it is larger (for high-water marks).
+	void raise(uint64_t v)
+	{
+		if (v > value_.load(std::memory_order_relaxed))
+		{
+			value_.store(v, std::memory_order_relaxed);
+		}
+	}
+
+	uint64_t load() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value_;
+};
+
+#endif // COUNTER_H
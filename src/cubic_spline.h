@@ -0,0 +1,141 @@
+#ifndef CUBIC_SPLINE_H
+#define CUBIC_SPLINE_H
+
+#include <algorithm>
+#include <cassert>
+
+// Natural cubic spline through at most MAX_POINTS points, held in fixed
+// arrays so that fitting and evaluating it never touches the heap. It runs
+// the same arithmetic as tk::spline with its default (zero curvature)
+// boundary conditions, step for step, so both give identical paths; the
+// planner fits one for every cycle.
+class CubicSpline
+{
+public:
+	static const int MAX_POINTS = 8;
+
+	CubicSpline() : n_(0) {}
+
+	// x must be strictly increasing.
+	void set_points(const double *x, const double *y, int n)
+	{
+		assert(n > 2 && n <= MAX_POINTS);
+		n_ = n;
+		for (int i = 0; i < n; i++)
+		{
+			m_x_[i] = x[i];
+			m_y_[i] = y[i];
+		}
+		for (int i = 0; i < n - 1; i++)
+		{
+			assert(m_x_[i] < m_x_[i + 1]);
+		}
+
+		// Tridiagonal system for b[]: A(i,i-1), A(i,i), A(i,i+1) are
+		// lower[i], diag[i], upper[i].
+		double lower[MAX_POINTS] = {0};
+		double diag[MAX_POINTS] = {0};
+		double upper[MAX_POINTS] = {0};
+		double rhs[MAX_POINTS] = {0};
+		for (int i = 1; i < n - 1; i++)
+		{
+			lower[i] = 1.0 / 3.0 * (x[i] - x[i - 1]);
+			diag[i] = 2.0 / 3.0 * (x[i + 1] - x[i - 1]);
+			upper[i] = 1.0 / 3.0 * (x[i + 1] - x[i]);
+			rhs[i] = (y[i + 1] - y[i]) / (x[i + 1] - x[i]) - (y[i] - y[i - 1]) / (x[i] - x[i - 1]);
+		}
+		// zero curvature at both ends: 2*b[0] = 0, 2*b[n-1] = 0
+		diag[0] = 2.0;
+		upper[0] = 0.0;
+		rhs[0] = 0.0;
+		diag[n - 1] = 2.0;
+		lower[n - 1] = 0.0;
+		rhs[n - 1] = 0.0;
+
+		// LU decomposition as tk::band_matrix does it: scale every row so
+		// that its diagonal is 1, then eliminate the lower band.
+		double saved_diag[MAX_POINTS];
+		for (int i = 0; i < n; i++)
+		{
+			saved_diag[i] = 1.0 / diag[i];
+			if (i > 0)
+			{
+				lower[i] *= saved_diag[i];
+			}
+			if (i < n - 1)
+			{
+				upper[i] *= saved_diag[i];
+			}
+			diag[i] = 1.0;
+		}
+		for (int k = 0; k < n - 1; k++)
+		{
+			double f = -lower[k + 1] / diag[k];
+			lower[k + 1] = -f;
+			diag[k + 1] = diag[k + 1] + f * upper[k];
+		}
+
+		// Ly = rhs, then Rb = y
+		double l[MAX_POINTS];
+		for (int i = 0; i < n; i++)
+		{
+			double sum = 0;
+			if (i > 0)
+			{
+				sum += lower[i] * l[i - 1];
+			}
+			l[i] = (rhs[i] * saved_diag[i]) - sum;
+		}
+		for (int i = n - 1; i >= 0; i--)
+		{
+			double sum = 0;
+			if (i < n - 1)
+			{
+				sum += upper[i] * m_b_[i + 1];
+			}
+			m_b_[i] = (l[i] - sum) / diag[i];
+		}
+
+		for (int i = 0; i < n - 1; i++)
+		{
+			m_a_[i] = 1.0 / 3.0 * (m_b_[i + 1] - m_b_[i]) / (x[i + 1] - x[i]);
+			m_c_[i] = (y[i + 1] - y[i]) / (x[i + 1] - x[i]) - 1.0 / 3.0 * (2.0 * m_b_[i] + m_b_[i + 1]) * (x[i + 1] - x[i]);
+		}
+
+		// extrapolation: quadratic to the left, and to the right with the
+		// slope at the last point
+		m_b0_ = m_b_[0];
+		m_c0_ = m_c_[0];
+		double h = x[n - 1] - x[n - 2];
+		m_a_[n - 1] = 0.0;
+		m_c_[n - 1] = 3.0 * m_a_[n - 2] * h * h + 2.0 * m_b_[n - 2] * h + m_c_[n - 2];
+	}
+
+	double operator()(double x) const
+	{
+		int idx = std::max(int(std::lower_bound(m_x_, m_x_ + n_, x) - m_x_) - 1, 0);
+		double h = x - m_x_[idx];
+		if (x < m_x_[0])
+		{
+			return (m_b0_ * h + m_c0_) * h + m_y_[0];
+		}
+		else if (x > m_x_[n_ - 1])
+		{
+			return (m_b_[n_ - 1] * h + m_c_[n_ - 1]) * h + m_y_[n_ - 1];
+		}
+		return ((m_a_[idx] * h + m_b_[idx]) * h + m_c_[idx]) * h + m_y_[idx];
+	}
+
+private:
+	int n_;
+	double m_x_[MAX_POINTS];
+	double m_y_[MAX_POINTS];
+	// f(x) = a*(x-x_i)^3 + b*(x-x_i)^2 + c*(x-x_i) + y_i
+	double m_a_[MAX_POINTS];
+	double m_b_[MAX_POINTS];
+	double m_c_[MAX_POINTS];
+	double m_b0_;
+	double m_c0_;
+};
+
+#endif // CUBIC_SPLINE_H
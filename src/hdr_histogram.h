@@ -0,0 +1,192 @@
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Log-linear ("HDR") histogram of non-negative integer values, typically
+// nanoseconds. Values below 128 are counted exactly; above that every power
+// of two is split into 64 equal buckets, so any recorded value is off by at
+// most 1/64 (1.6%) when read back. Covers values up to 2^40 (about 18
+// minutes in ns) in a fixed 2304-bucket array; larger values are clamped.
+namespace hdr
+{
+	static const int SUB_BUCKET_BITS = 7;
+	static const uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;        // 128
+	static const uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;          // 64
+	static const int MAX_VALUE_BITS = 40;
+	static const size_t BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF;
+	static const uint64_t MAX_VALUE = (uint64_t(1) << MAX_VALUE_BITS) - 1;
+
+	inline size_t indexOf(uint64_t value)
+	{
+		value = std::min(value, MAX_VALUE);
+		if (value < SUB_BUCKET_COUNT)
+		{
+			return value;
+		}
+		int shift = (63 - __builtin_clzll(value)) - (SUB_BUCKET_BITS - 1);
+		return shift * SUB_BUCKET_HALF + (value >> shift);
+	}
+
+	// Smallest value that lands in bucket 'index'.
+	inline uint64_t lowestValueAt(size_t index)
+	{
+		if (index < SUB_BUCKET_COUNT)
+		{
+			return index;
+		}
+		size_t shift = index / SUB_BUCKET_HALF - 1;
+		uint64_t sub = index - shift * SUB_BUCKET_HALF;
+		return sub << shift;
+	}
+
+	// Value reported for bucket 'index': the middle of its range.
+	inline uint64_t medianValueAt(size_t index)
+	{
+		if (index < SUB_BUCKET_COUNT)
+		{
+			return index;
+		}
+		return lowestValueAt(index) + (lowestValueAt(index + 1) - lowestValueAt(index)) / 2;
+	}
+}
+
+// Plain histogram for a single thread, or a merged snapshot.
+class HdrHistogram
+{
+public:
+	HdrHistogram() { reset(); }
+
+	void reset()
+	{
+		memset(counts_, 0, sizeof(counts_));
+		total_ = 0;
+		sum_ = 0;
+		min_ = UINT64_MAX;
+		max_ = 0;
+	}
+
+	void record(uint64_t value, uint64_t count = 1)
+	{
+		counts_[hdr::indexOf(value)] += count;
+		total_ += count;
+		sum_ += value * count;
+		min_ = std::min(min_, value);
+		max_ = std::max(max_, value);
+	}
+
+	void add(const HdrHistogram &other)
+	{
+		for (size_t i = 0; i < hdr::BUCKETS; i++)
+		{
+			counts_[i] += other.counts_[i];
+		}
+		total_ += other.total_;
+		sum_ += other.sum_;
+		min_ = std::min(min_, other.min_);
+		max_ = std::max(max_, other.max_);
+	}
+
+	uint64_t count() const { return total_; }
+	uint64_t sum() const { return sum_; }
+	uint64_t min() const { return total_ ? min_ : 0; }
+	uint64_t max() const { return max_; }
+	double mean() const { return total_ ? (double)sum_ / total_ : 0; }
+	uint64_t countAt(size_t index) const { return counts_[index]; }
+
+	// Value at or below which 'percentile' (0..100) of the values lie.
+	uint64_t percentile(double percentile) const
+	{
+		if (total_ == 0)
+		{
+			return 0;
+		}
+		uint64_t wanted = std::max<uint64_t>(1, (uint64_t)(percentile / 100.0 * total_ + 0.5));
+		uint64_t seen = 0;
+		for (size_t i = 0; i < hdr::BUCKETS; i++)
+		{
+			seen += counts_[i];
+			if (seen >= wanted)
+			{
+				return std::min(std::max(hdr::medianValueAt(i), min()), max_);
+			}
+		}
+		return max_;
+	}
+
+private:
+	friend class ConcurrentHdrHistogram;
+
+	uint64_t counts_[hdr::BUCKETS];
+	uint64_t total_;
+	uint64_t sum_;
+	uint64_t min_;
+	uint64_t max_;
+};
+
+// Histogram with exactly one writing thread and any number of readers.
+// record() is a handful of relaxed loads and stores, no read-modify-write,
+// so the owning thread never waits; readers may see a sample half recorded
+// (counted but not yet summed), which is fine for monitoring.
+class ConcurrentHdrHistogram
+{
+public:
+	ConcurrentHdrHistogram()
+	{
+		for (auto &c : counts_)
+		{
+			c.store(0, std::memory_order_relaxed);
+		}
+		total_.store(0, std::memory_order_relaxed);
+		sum_.store(0, std::memory_order_relaxed);
+		min_.store(UINT64_MAX, std::memory_order_relaxed);
+		max_.store(0, std::memory_order_relaxed);
+	}
+
+	void record(uint64_t value)
+	{
+		std::atomic<uint64_t> &c = counts_[hdr::indexOf(value)];
+		c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		total_.store(total_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		if (value < min_.load(std::memory_order_relaxed))
+		{
+			min_.store(value, std::memory_order_relaxed);
+		}
+		if (value > max_.load(std::memory_order_relaxed))
+		{
+			max_.store(value, std::memory_order_relaxed);
+		}
+	}
+
+	// Adds the current contents to 'into'.
+	void snapshotInto(HdrHistogram &into) const
+	{
+		uint64_t total = 0;
+		for (size_t i = 0; i < hdr::BUCKETS; i++)
+		{
+			uint64_t c = counts_[i].load(std::memory_order_relaxed);
+			into.counts_[i] += c;
+			total += c;
+		}
+		into.total_ += total;
+		into.sum_ += sum_.load(std::memory_order_relaxed);
+		if (total)
+		{
+			into.min_ = std::min(into.min_, min_.load(std::memory_order_relaxed));
+			into.max_ = std::max(into.max_, max_.load(std::memory_order_relaxed));
+		}
+	}
+
+private:
+	std::atomic<uint64_t> counts_[hdr::BUCKETS];
+	std::atomic<uint64_t> total_;
+	std::atomic<uint64_t> sum_;
+	std::atomic<uint64_t> min_;
+	std::atomic<uint64_t> max_;
+};
+
+#endif // HDR_HISTOGRAM_H
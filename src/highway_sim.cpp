@@ -0,0 +1,270 @@
+#include "highway_sim.h"
+#include <math.h>
+#include <algorithm>
+#include "json.hpp"
+#include "protocol.h"
+
+using namespace std;
+
+// for convenience
+using json = nlohmann::json;
+
+constexpr double HighwaySim::TICK;
+
+static const double MPH_PER_MS = 2.23694;
+// Other cars stay within this distance of the ego car; beyond it they are
+// put back into view, like the real simulator does.
+static const double VISIBLE_RANGE = 300;
+// Minimal centre distance of two cars in metres before they count as touching.
+static const double CAR_LENGTH = 4.5;
+static const double CAR_WIDTH = 2.0;
+
+HighwaySim::HighwaySim(const MapWaypoints &map, unsigned seed, int vehicles)
+	: map_(map), rng_(seed), speed_(0), path_next_(0), ticks_(0), distance_driven_(0), collisions_(0)
+{
+	size_t last = map_.x.size() - 1;
+	max_s_ = map_.s[last] + distance(map_.x[last], map_.y[last], map_.x[0], map_.y[0]);
+
+	// Same start as the term3 simulator: standing in the middle lane, a bit
+	// past the first waypoint, facing along the road.
+	s_ = map_.s[0] + 124.834;
+	d_ = map_.lanes.center(map_.lanes.count / 2);
+	vector<double> xy = getXY(s_, d_, map_.s, map_.x, map_.y);
+	x_ = xy[0];
+	y_ = xy[1];
+	vector<double> ahead = getXY(s_ + 1, d_, map_.s, map_.x, map_.y);
+	yaw_ = atan2(ahead[1] - y_, ahead[0] - x_);
+
+	for (int i = 0; i < vehicles; i++)
+	{
+		SimVehicle v;
+		v.id = i;
+		respawn(v, i % 2 == 0);
+		vehicles_.push_back(v);
+	}
+	touching_.assign(vehicles_.size(), false);
+}
+
+double HighwaySim::wrap(double s) const
+{
+	s = fmod(s, max_s_);
+	return s < 0 ? s + max_s_ : s;
+}
+
+// Signed distance along the road from 'from' to 'to', taking the shortest
+// way around the loop.
+double HighwaySim::gap(double from, double to) const
+{
+	double g = wrap(to - from);
+	return g > max_s_ / 2 ? g - max_s_ : g;
+}
+
+void HighwaySim::respawn(SimVehicle &v, bool ahead)
+{
+	const LaneModel &lanes = map_.lanes;
+	uniform_int_distribution<int> lane(0, lanes.count - 1);
+	uniform_real_distribution<double> offset(30, VISIBLE_RANGE * 0.8);
+	// Traffic drives +-10 MPH around the 50 MPH limit.
+	uniform_real_distribution<double> speed(40 / MPH_PER_MS, 60 / MPH_PER_MS);
+
+	for (int attempt = 0; attempt < 20; attempt++)
+	{
+		v.d = v.target_d = lanes.center(lane(rng_));
+		v.s = wrap(s_ + (ahead ? offset(rng_) : -offset(rng_)));
+		bool free = true;
+		for (const auto &other : vehicles_)
+		{
+			if (other.id != v.id && fabs(other.d - v.d) < lanes.width / 2 && fabs(gap(other.s, v.s)) < 20)
+			{
+				free = false;
+				break;
+			}
+		}
+		if (free)
+		{
+			break;
+		}
+	}
+	v.target_speed = speed(rng_);
+	v.speed = v.target_speed;
+}
+
+string HighwaySim::telemetryMessage() const
+{
+	json data;
+	data["x"] = x_;
+	data["y"] = y_;
+	data["s"] = s_;
+	data["d"] = d_;
+	data["yaw"] = rad2deg(yaw_);
+	data["speed"] = speed_ * MPH_PER_MS;
+
+	vector<double> previous_path_x(path_x_.begin() + path_next_, path_x_.end());
+	vector<double> previous_path_y(path_y_.begin() + path_next_, path_y_.end());
+	double end_path_s = 0;
+	double end_path_d = 0;
+	if (previous_path_x.size() >= 2)
+	{
+		size_t n = previous_path_x.size();
+		double theta = atan2(previous_path_y[n - 1] - previous_path_y[n - 2], previous_path_x[n - 1] - previous_path_x[n - 2]);
+		vector<double> sd = getFrenet(previous_path_x[n - 1], previous_path_y[n - 1], theta, map_.x, map_.y);
+		end_path_s = sd[0];
+		end_path_d = sd[1];
+	}
+	data["previous_path_x"] = previous_path_x;
+	data["previous_path_y"] = previous_path_y;
+	data["end_path_s"] = end_path_s;
+	data["end_path_d"] = end_path_d;
+
+	json sensor_fusion = json::array();
+	for (const auto &v : vehicles_)
+	{
+		vector<double> xy = getXY(v.s, v.d, map_.s, map_.x, map_.y);
+		vector<double> ahead = getXY(v.s + 1, v.d, map_.s, map_.x, map_.y);
+		double heading = atan2(ahead[1] - xy[1], ahead[0] - xy[0]);
+		sensor_fusion.push_back({v.id, xy[0], xy[1], v.speed * cos(heading), v.speed * sin(heading), v.s, v.d});
+	}
+	data["sensor_fusion"] = sensor_fusion;
+
+	return "42[\"telemetry\"," + data.dump() + "]";
+}
+
+bool HighwaySim::applyControl(const string &message)
+{
+	string s = hasData(message);
+	if (s == "")
+	{
+		return false;
+	}
+	auto j = json::parse(s);
+	if (j[0].get<string>() != "control")
+	{
+		return false;
+	}
+	path_x_ = j[1]["next_x"].get<vector<double>>();
+	path_y_ = j[1]["next_y"].get<vector<double>>();
+	path_next_ = 0;
+	return true;
+}
+
+void HighwaySim::advance(int ticks)
+{
+	for (int t = 0; t < ticks; t++)
+	{
+		// The controller is perfect: the car is exactly at the next point.
+		if (path_next_ < path_x_.size() && path_next_ < path_y_.size())
+		{
+			double nx = path_x_[path_next_];
+			double ny = path_y_[path_next_];
+			double moved = distance(x_, y_, nx, ny);
+			if (moved > 1e-3)
+			{
+				yaw_ = atan2(ny - y_, nx - x_);
+			}
+			speed_ = moved / TICK;
+			distance_driven_ += moved;
+			x_ = nx;
+			y_ = ny;
+			path_next_++;
+		}
+		else
+		{
+			speed_ = 0;
+		}
+		vector<double> sd = getFrenet(x_, y_, yaw_, map_.x, map_.y);
+		s_ = wrap(sd[0]);
+		d_ = sd[1];
+
+		stepVehicles();
+		ticks_++;
+	}
+}
+
+void HighwaySim::stepVehicles()
+{
+	uniform_real_distribution<double> chance(0, 1);
+	const LaneModel &lanes = map_.lanes;
+
+	for (size_t i = 0; i < vehicles_.size(); i++)
+	{
+		SimVehicle &v = vehicles_[i];
+
+		// Follow the closest car ahead in the lane we are in or moving to.
+		double leader_gap = 1e9;
+		double leader_speed = v.target_speed;
+		for (const auto &other : vehicles_)
+		{
+			if (other.id == v.id)
+			{
+				continue;
+			}
+			bool same_lane = fabs(other.d - v.d) < lanes.width / 2 || fabs(other.d - v.target_d) < lanes.width / 2;
+			double g = gap(v.s, other.s);
+			if (same_lane && g > 0 && g < leader_gap)
+			{
+				leader_gap = g;
+				leader_speed = other.speed;
+			}
+		}
+		// Nobody wants to run into the ego car either.
+		bool ego_in_lane = fabs(d_ - v.d) < lanes.width / 2 || fabs(d_ - v.target_d) < lanes.width / 2;
+		double ego_gap = gap(v.s, s_);
+		if (ego_in_lane && ego_gap > 0 && ego_gap < leader_gap)
+		{
+			leader_gap = ego_gap;
+			leader_speed = speed_;
+		}
+		double wanted = v.target_speed;
+		if (leader_gap < 30)
+		{
+			wanted = min(wanted, leader_speed * (leader_gap < 15 ? 0.9 : 1.0));
+		}
+		double accel = max(-5.0, min(2.0, (wanted - v.speed) / 1.0));
+		v.speed = max(0.0, v.speed + accel * TICK);
+
+		// Once in a while change to a neighbouring lane with enough room.
+		if (v.d == v.target_d && chance(rng_) < 0.1 * TICK)
+		{
+			int lane = (int)(v.d / lanes.width);
+			int to = lane + (chance(rng_) < 0.5 ? -1 : 1);
+			if (to >= 0 && to < lanes.count)
+			{
+				double to_d = lanes.center(to);
+				bool free = fabs(d_ - to_d) >= lanes.width / 2 || fabs(gap(v.s, s_)) >= 20;
+				for (const auto &other : vehicles_)
+				{
+					if (other.id != v.id && fabs(other.d - to_d) < lanes.width / 2 && fabs(gap(v.s, other.s)) < 20)
+					{
+						free = false;
+						break;
+					}
+				}
+				if (free)
+				{
+					v.target_d = to_d;
+				}
+			}
+		}
+		if (v.d != v.target_d)
+		{
+			double step = 2.0 * TICK;  // 2 m/s sideways
+			v.d = fabs(v.target_d - v.d) <= step ? v.target_d : v.d + (v.target_d > v.d ? step : -step);
+		}
+
+		v.s = wrap(v.s + v.speed * TICK);
+
+		// Keep traffic around the ego car.
+		double from_ego = gap(s_, v.s);
+		if (fabs(from_ego) > VISIBLE_RANGE)
+		{
+			respawn(v, from_ego < 0);
+		}
+
+		bool touching = fabs(gap(s_, v.s)) < CAR_LENGTH && fabs(v.d - d_) < CAR_WIDTH;
+		if (touching && !touching_[i])
+		{
+			collisions_++;
+		}
+		touching_[i] = touching;
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef HIGHWAY_SIM_H
+#define HIGHWAY_SIM_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "planner.h"
+
+// Another car on the road, simulated in Frenet coordinates.
+struct SimVehicle
+{
+	int id;
+	double s;
+	double d;
+	double speed;         // m/s along the road
+	double target_speed;  // what the driver would like to go
+	double target_d;      // lane centre it is in or changing to
+};
+
+// Headless stand-in for the term3 simulator: the ego car drives exactly
+// along the (x,y) points it was sent, one point per .02 second tick, and a
+// handful of other cars keep their lane, follow their leader and now and
+// then change lanes. Simulated time only advances in advance(), so a client
+// can run it as fast as the planner answers.
+class HighwaySim
+{
+public:
+	static constexpr double TICK = 0.02;  // seconds per path point
+
+	HighwaySim(const MapWaypoints &map, unsigned seed, int vehicles = 12);
+
+	// The "42[\"telemetry\",{...}]" message the simulator would send now.
+	std::string telemetryMessage() const;
+
+	// Takes the path of a "42[\"control\",...]" message as the new path to
+	// drive. Returns false (and keeps the old path) for any other message.
+	bool applyControl(const std::string &message);
+
+	// Moves simulated time forward by 'ticks' .02 second steps.
+	void advance(int ticks);
+
+	double time() const { return ticks_ * TICK; }
+	double distanceDriven() const { return distance_driven_; }
+	uint64_t collisions() const { return collisions_; }
+
+private:
+	void stepVehicles();
+	void respawn(SimVehicle &v, bool ahead);
+	double wrap(double s) const;
+	double gap(double from, double to) const;
+
+	const MapWaypoints &map_;
+	double max_s_;
+	std::mt19937 rng_;
+
+	// Ego car
+	double x_, y_, yaw_, speed_;
+	double s_, d_;
+	std::vector<double> path_x_;
+	std::vector<double> path_y_;
+	size_t path_next_;
+
+	std::vector<SimVehicle> vehicles_;
+	std::vector<bool> touching_;
+
+	uint64_t ticks_;
+	double distance_driven_;
+	uint64_t collisions_;
+};
+
+#endif // HIGHWAY_SIM_H
@@ -0,0 +1,148 @@
+#include "jmt.h"
+#include <math.h>
+#include <algorithm>
+// Eigen 3.3 predates GCC's -Wint-in-bool-context and trips it.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-in-bool-context"
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/LU"
+#pragma GCC diagnostic pop
+
+using namespace std;
+
+namespace
+{
+	Eigen::Matrix3d jmtSystem(double T)
+	{
+		const double T2 = T * T;
+		const double T3 = T2 * T;
+		const double T4 = T3 * T;
+		const double T5 = T4 * T;
+		Eigen::Matrix3d A;
+		A << T3, T4, T5,
+			3 * T2, 4 * T3, 5 * T4,
+			6 * T, 12 * T2, 20 * T3;
+		return A;
+	}
+
+	// The inverted systems of the horizon grid.
+	struct JmtInverseTable
+	{
+		double inverse[JMT_HORIZONS][3][3];
+
+		JmtInverseTable()
+		{
+			for (int h = 0; h < JMT_HORIZONS; h++)
+			{
+				Eigen::Matrix3d inverted = jmtSystem(JMT_MIN_HORIZON + h * JMT_HORIZON_STEP).inverse();
+				for (int r = 0; r < 3; r++)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						inverse[h][r][c] = inverted(r, c);
+					}
+				}
+			}
+		}
+	};
+
+	const JmtInverseTable &inverseTable()
+	{
+		static const JmtInverseTable table;
+		return table;
+	}
+
+	// Index of T in the horizon grid, -1 if it is not on it.
+	int horizonIndex(double T)
+	{
+		long h = lround((T - JMT_MIN_HORIZON) / JMT_HORIZON_STEP);
+		if (h < 0 || h >= JMT_HORIZONS || fabs(JMT_MIN_HORIZON + h * JMT_HORIZON_STEP - T) > 1e-9)
+		{
+			return -1;
+		}
+		return (int)h;
+	}
+
+	// What is left of the end state after the lower three coefficients,
+	// which the start state fixes.
+	void remainder(const JmtBoundary &start, const JmtBoundary &end, double T, double T2, double r[3])
+	{
+		r[0] = end.x - (start.x + start.v * T + 0.5 * start.a * T2);
+		r[1] = end.v - (start.v + start.a * T);
+		r[2] = end.a - start.a;
+	}
+
+	void setLower(const JmtBoundary &start, Quintic &q)
+	{
+		q.c[0] = start.x;
+		q.c[1] = start.v;
+		q.c[2] = 0.5 * start.a;
+	}
+}
+
+void solveJmt(const JmtBoundary *starts, const JmtBoundary *ends, int n, double T, Quintic *out)
+{
+	const double T2 = T * T;
+	int h = horizonIndex(T);
+	if (h >= 0)
+	{
+		const double (&m)[3][3] = inverseTable().inverse[h];
+		for (int i = 0; i < n; i++)
+		{
+			double r[3];
+			remainder(starts[i], ends[i], T, T2, r);
+			Quintic &q = out[i];
+			setLower(starts[i], q);
+			q.c[3] = m[0][0] * r[0] + m[0][1] * r[1] + m[0][2] * r[2];
+			q.c[4] = m[1][0] * r[0] + m[1][1] * r[1] + m[1][2] * r[2];
+			q.c[5] = m[2][0] * r[0] + m[2][1] * r[1] + m[2][2] * r[2];
+		}
+		return;
+	}
+
+	Eigen::PartialPivLU<Eigen::Matrix3d> lu(jmtSystem(T));
+	for (int first = 0; first < n; first += JMT_BATCH)
+	{
+		int count = min(JMT_BATCH, n - first);
+		Eigen::Matrix<double, 3, JMT_BATCH> rhs = Eigen::Matrix<double, 3, JMT_BATCH>::Zero();
+		for (int i = 0; i < count; i++)
+		{
+			double r[3];
+			remainder(starts[first + i], ends[first + i], T, T2, r);
+			rhs(0, i) = r[0];
+			rhs(1, i) = r[1];
+			rhs(2, i) = r[2];
+		}
+		Eigen::Matrix<double, 3, JMT_BATCH> upper = lu.solve(rhs);
+		for (int i = 0; i < count; i++)
+		{
+			Quintic &q = out[first + i];
+			setLower(starts[first + i], q);
+			q.c[3] = upper(0, i);
+			q.c[4] = upper(1, i);
+			q.c[5] = upper(2, i);
+		}
+	}
+}
+
+void samplePositions(const Quintic &q, double t0, double dt, int n, double *x)
+{
+	const double c0 = q.c[0], c1 = q.c[1], c2 = q.c[2], c3 = q.c[3], c4 = q.c[4], c5 = q.c[5];
+	for (int i = 0; i < n; i++)
+	{
+		double t = t0 + i * dt;
+		x[i] = ((((c5 * t + c4) * t + c3) * t + c2) * t + c1) * t + c0;
+	}
+}
+
+void peakAccelerationJerk(const Quintic &q, double T, int n, double &acceleration, double &jerk)
+{
+	acceleration = 0;
+	jerk = 0;
+	for (int i = 0; i <= n; i++)
+	{
+		double t = T * i / n;
+		acceleration = max(acceleration, fabs(q.acceleration(t)));
+		jerk = max(jerk, fabs(q.jerk(t)));
+	}
+}
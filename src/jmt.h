@@ -0,0 +1,54 @@
+#ifndef JMT_H
+#define JMT_H
+
+// Jerk minimising trajectories: the quintic x(t) = c0 + c1 t + ... + c5 t^5
+// that moves from one position, velocity and acceleration to another in T
+// seconds with the least integrated squared jerk.
+
+// Position, velocity and acceleration along one axis (s or d).
+struct JmtBoundary
+{
+	double x;
+	double v;
+	double a;
+};
+
+struct Quintic
+{
+	double c[6];
+
+	double position(double t) const { return ((((c[5] * t + c[4]) * t + c[3]) * t + c[2]) * t + c[1]) * t + c[0]; }
+	double velocity(double t) const { return (((5 * c[5] * t + 4 * c[4]) * t + 3 * c[3]) * t + 2 * c[2]) * t + c[1]; }
+	double acceleration(double t) const { return ((20 * c[5] * t + 12 * c[4]) * t + 6 * c[3]) * t + 2 * c[2]; }
+	double jerk(double t) const { return (60 * c[5] * t + 24 * c[4]) * t + 6 * c[3]; }
+
+	JmtBoundary boundary(double t) const { return JmtBoundary{position(t), velocity(t), acceleration(t)}; }
+};
+
+// Trajectories solved together by solveJmt(), one column of a fixed-size
+// right-hand side each.
+const int JMT_BATCH = 8;
+
+// Horizons whose inverted system solveJmt() has precomputed: JMT_MIN_HORIZON
+// to JMT_MAX_HORIZON in JMT_HORIZON_STEP steps (s).
+const double JMT_MIN_HORIZON = 0.5;
+const double JMT_MAX_HORIZON = 6;
+const double JMT_HORIZON_STEP = 0.1;
+const int JMT_HORIZONS = 56;
+
+// Fills out[i] with the trajectory from starts[i] to ends[i] in T seconds,
+// for n trajectories that share T. The 3x3 system for the upper three
+// coefficients only depends on T. For a T on the horizon grid its inverse
+// comes from a table built on first use, and each trajectory is one 3x3
+// matrix-vector multiply; any other T is factorised once and solved for
+// JMT_BATCH end states at a time. Neither touches the heap.
+void solveJmt(const JmtBoundary *starts, const JmtBoundary *ends, int n, double T, Quintic *out);
+
+// Writes the positions at t0, t0 + dt, ... to x[0..n). Each sample is an
+// independent Horner evaluation, so the loop vectorises across samples.
+void samplePositions(const Quintic &q, double t0, double dt, int n, double *x);
+
+// Largest |acceleration| and |jerk| at n samples over [0, T].
+void peakAccelerationJerk(const Quintic &q, double T, int n, double &acceleration, double &jerk);
+
+#endif // JMT_H
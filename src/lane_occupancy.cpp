@@ -0,0 +1,121 @@
+#include "lane_occupancy.h"
+#include <algorithm>
+
+using namespace std;
+
+template <int LANES>
+LaneOccupancy<LANES>::LaneOccupancy()
+{
+	lane_of_.reserve(32);
+	for (size_t lane = 0; lane < rows_.size(); lane++)
+	{
+		rows_[lane].reserve(32);
+		s_[lane].reserve(32);
+	}
+}
+
+template <int LANES>
+void LaneOccupancy<LANES>::build(const VehicleTable &vehicles, const LaneModel &model)
+{
+	// A constant, and the lane loops below unrolled, unless LANES is
+	// DYNAMIC_LANES.
+	const int lanes = LANES == DYNAMIC_LANES ? model.count : LANES;
+	const double width = model.width;
+	LaneArray<LANES, vector<int> >::resize(rows_, lanes);
+	LaneArray<LANES, vector<double> >::resize(s_, lanes);
+
+	int n = vehicles.size();
+	lane_of_.resize(n);
+	for (int lane = 0; lane < lanes; lane++)
+	{
+		rows_[lane].clear();
+		s_[lane].clear();
+		// Room for every car in one lane, so that a lane only grows when the
+		// frame has more cars than any before (the DYNAMIC_LANES buckets
+		// start out empty).
+		rows_[lane].reserve(n);
+		s_[lane].reserve(n);
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		// Same bounds (and float precision) as the planner has always used.
+		float d = vehicles.d[i];
+		lane_of_[i] = -1;
+		for (int lane = 0; lane < lanes; lane++)
+		{
+			if (d < (width * lane + width) && d > (width * lane))
+			{
+				lane_of_[i] = lane;
+				rows_[lane].push_back(i);
+				break;
+			}
+		}
+	}
+
+	const vector<double> &predicted_s = vehicles.predicted_s;
+	for (int lane = 0; lane < lanes; lane++)
+	{
+		vector<int> &rows = rows_[lane];
+		sort(rows.begin(), rows.end(), [&predicted_s](int a, int b) { return predicted_s[a] < predicted_s[b]; });
+		for (int row : rows)
+		{
+			s_[lane].push_back(predicted_s[row]);
+		}
+	}
+}
+
+// Both predicates are monotonic in the car's s, which is what makes the
+// binary searches below equivalent to checking every car.
+template <int LANES>
+size_t LaneOccupancy<LANES>::firstAhead(int lane, double s, double clearance) const
+{
+	const vector<double> &cars = s_[lane];
+	return partition_point(cars.begin(), cars.end(), [s, clearance](double car_s) {
+		return !(car_s > s && (car_s - s) > clearance);
+	}) - cars.begin();
+}
+
+template <int LANES>
+size_t LaneOccupancy<LANES>::countBehind(int lane, double s, double clearance) const
+{
+	const vector<double> &cars = s_[lane];
+	return partition_point(cars.begin(), cars.end(), [s, clearance](double car_s) {
+		return car_s < s && (s - car_s) > clearance;
+	}) - cars.begin();
+}
+
+template <int LANES>
+int LaneOccupancy<LANES>::leader(int lane, double s, double clearance, double &gap) const
+{
+	size_t ahead = firstAhead(lane, s, clearance);
+	if (ahead == s_[lane].size())
+	{
+		return -1;
+	}
+	gap = s_[lane][ahead] - s;
+	return rows_[lane][ahead];
+}
+
+template <int LANES>
+int LaneOccupancy<LANES>::follower(int lane, double s, double clearance, double &gap) const
+{
+	size_t behind = countBehind(lane, s, clearance);
+	if (behind == 0)
+	{
+		return -1;
+	}
+	gap = s - s_[lane][behind - 1];
+	return rows_[lane][behind - 1];
+}
+
+template <int LANES>
+bool LaneOccupancy<LANES>::occupied(int lane, double s, double behind, double ahead) const
+{
+	return countBehind(lane, s, behind) < firstAhead(lane, s, ahead);
+}
+
+template class LaneOccupancy<2>;
+template class LaneOccupancy<3>;
+template class LaneOccupancy<4>;
+template class LaneOccupancy<DYNAMIC_LANES>;
@@ -0,0 +1,97 @@
+#ifndef LANE_OCCUPANCY_H
+#define LANE_OCCUPANCY_H
+
+#include <array>
+#include <vector>
+#include "vehicle_table.h"
+
+// Lanes of a road, numbered from the yellow line outwards: lane k spans d
+// in (k * width, (k + 1) * width). The simulator's highway has three 4 m
+// lanes.
+struct LaneModel
+{
+	int count = 3;
+	double width = 4;
+
+	double center(int lane) const { return width * lane + width / 2; }
+
+	// Lane of a car at 'd', -1 on a lane marking or off the road. Compares
+	// in float like the planner always has.
+	int laneOf(double d) const
+	{
+		float f = d;
+		for (int lane = 0; lane < count; lane++)
+		{
+			if (f < (width * lane + width) && f > (width * lane))
+			{
+				return lane;
+			}
+		}
+		return -1;
+	}
+};
+
+// Lane count template argument for roads whose count is only known at run
+// time; the code is then the same, with LaneModel::count in its loops.
+const int DYNAMIC_LANES = 0;
+
+// Per lane storage: a fixed array for a compile-time count, so that the
+// per lane loops unroll, otherwise a vector sized from the model.
+template <int LANES, typename T>
+struct LaneArray
+{
+	typedef std::array<T, LANES> type;
+	static void resize(type &, int) {}
+};
+
+template <typename T>
+struct LaneArray<DYNAMIC_LANES, T>
+{
+	typedef std::vector<T> type;
+	static void resize(type &lanes, int count) { lanes.resize(count); }
+};
+
+// The cars of one frame bucketed by lane and sorted by predicted s, so that
+// "who is ahead of / behind s in lane k" is a binary search instead of a
+// scan of the whole sensor fusion list. Built once per frame after
+// VehicleTable::predict(); reusing an instance keeps its capacity.
+// Instantiated for 2, 3, 4 and DYNAMIC_LANES lanes (lane_occupancy.cpp).
+template <int LANES>
+class LaneOccupancy
+{
+public:
+	LaneOccupancy();
+
+	// Rebuilds the index from the d and predicted_s columns of 'vehicles'.
+	// 'model' must have LANES lanes unless LANES is DYNAMIC_LANES.
+	void build(const VehicleTable &vehicles, const LaneModel &model);
+
+	// Lane of row 'row' of the table the index was built from, -1 for a
+	// car that is on a lane marking or off the road.
+	int laneOf(int row) const { return lane_of_[row]; }
+
+	// Row of the nearest car in 'lane' that is more than 'clearance' ahead
+	// of 's', and its distance in 'gap'; -1 if there is none.
+	int leader(int lane, double s, double clearance, double &gap) const;
+
+	// Row of the nearest car in 'lane' that is more than 'clearance' behind
+	// 's', and its distance in 'gap'; -1 if there is none.
+	int follower(int lane, double s, double clearance, double &gap) const;
+
+	// Whether a car in 'lane' is within 'behind' m behind to 'ahead' m in
+	// front of 's' (both inclusive).
+	bool occupied(int lane, double s, double behind, double ahead) const;
+
+private:
+	// Index into s_[lane] of the first car more than 'clearance' ahead.
+	size_t firstAhead(int lane, double s, double clearance) const;
+	// Number of cars in s_[lane] more than 'clearance' behind.
+	size_t countBehind(int lane, double s, double clearance) const;
+
+	std::vector<int> lane_of_;
+	// Per lane, rows and their predicted s in ascending order of s.
+	typename LaneArray<LANES, std::vector<int> >::type rows_;
+	typename LaneArray<LANES, std::vector<double> >::type s_;
+};
+
+#endif // LANE_OCCUPANCY_H
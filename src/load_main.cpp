@@ -0,0 +1,289 @@
+// Load generator: opens N concurrent simulator sessions against the planner,
+// each sending telemetry at a fixed rate, and reports round-trip latency
+// percentiles, deadline misses and server CPU as JSON.
+//
+// Usage: path_planning_load [--url URL] [--map FILE] [--lanes N] [--lane-width M]
+//                           [--sessions N] [--rate HZ] [--duration SECONDS]
+//                           [--deadline MS] [--vehicles C] [--seed S]
+//                           [--server-pid PID] [--report FILE]
+//
+// Sessions send on their own timer whether or not the previous frame was
+// answered, so a slow server sees the backlog the real simulator would
+// cause. A control message answers every frame still outstanding on that
+// session; its latency is taken from the oldest of them, i.e. how stale the
+// newest path was by the time it arrived. Frames answered together with a
+// newer one are counted as coalesced.
+#include <uWS/uWS.h>
+#include <uv.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "highway_sim.h"
+#include "json.hpp"
+#include "planner.h"
+
+using namespace std;
+
+// for convenience
+using json = nlohmann::json;
+
+struct LoadOptions {
+  string url = "ws://127.0.0.1:4567";
+  string map_file = "../data/highway_map.csv";
+  LaneModel lanes;  // of the simulated road; the server's must match
+  int sessions = 10;
+  double rate = 50;
+  double duration = 30;
+  double deadline_ms = 20;
+  int vehicles = 12;
+  unsigned seed = 1;
+  int server_pid = 0;
+  string report_file;
+};
+
+struct LoadSession {
+  int index;
+  unique_ptr<HighwaySim> sim;
+  unique_ptr<uWS::WebSocket<uWS::CLIENT>> ws;
+  bool connected = false;
+  uv_timer_t timer;
+  deque<chrono::steady_clock::time_point> outstanding;
+  struct LoadRun *run;
+};
+
+struct LoadRun {
+  LoadOptions options;
+  int ticks_per_frame;
+  vector<unique_ptr<LoadSession>> sessions;
+  vector<double> latencies_ms;
+  uint64_t frames_sent = 0;
+  uint64_t responses = 0;
+  uint64_t coalesced = 0;
+  uint64_t deadline_misses = 0;
+  uint64_t connect_failures = 0;
+  uint64_t disconnects = 0;
+  uint64_t collisions = 0;
+};
+
+// utime + stime of a process in seconds, or -1 if it can't be read.
+static double processCpuSeconds(int pid) {
+  ifstream stat("/proc/" + to_string(pid) + "/stat");
+  string line;
+  if (!getline(stat, line)) {
+    return -1;
+  }
+  // Skip "pid (comm)", the command name may contain spaces.
+  size_t close = line.rfind(')');
+  if (close == string::npos) {
+    return -1;
+  }
+  istringstream fields(line.substr(close + 2));
+  string field;
+  unsigned long utime = 0, stime = 0;
+  for (int i = 3; i <= 15 && fields >> field; i++) {
+    if (i == 14) {
+      utime = stoul(field);
+    } else if (i == 15) {
+      stime = stoul(field);
+    }
+  }
+  return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static double percentile(const vector<double> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[(size_t)(p * (sorted.size() - 1) + 0.5)];
+}
+
+static void sendTelemetry(uv_timer_t *timer) {
+  LoadSession *session = static_cast<LoadSession *>(timer->data);
+  if (!session->connected) {
+    return;
+  }
+  LoadRun *run = session->run;
+  session->sim->advance(run->ticks_per_frame);
+  string msg = session->sim->telemetryMessage();
+  session->outstanding.push_back(chrono::steady_clock::now());
+  session->ws->send(msg.data(), msg.length(), uWS::OpCode::TEXT);
+  run->frames_sent++;
+}
+
+int main(int argc, char *argv[]) {
+  LoadRun run;
+  LoadOptions &options = run.options;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--url" && has_value) {
+      options.url = argv[++i];
+    } else if (arg == "--map" && has_value) {
+      options.map_file = argv[++i];
+    } else if (arg == "--lanes" && has_value) {
+      options.lanes.count = max(1, atoi(argv[++i]));
+    } else if (arg == "--lane-width" && has_value) {
+      options.lanes.width = atof(argv[++i]);
+    } else if (arg == "--sessions" && has_value) {
+      options.sessions = atoi(argv[++i]);
+    } else if (arg == "--rate" && has_value) {
+      options.rate = atof(argv[++i]);
+    } else if (arg == "--duration" && has_value) {
+      options.duration = atof(argv[++i]);
+    } else if (arg == "--deadline" && has_value) {
+      options.deadline_ms = atof(argv[++i]);
+    } else if (arg == "--vehicles" && has_value) {
+      options.vehicles = atoi(argv[++i]);
+    } else if (arg == "--seed" && has_value) {
+      options.seed = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--server-pid" && has_value) {
+      options.server_pid = atoi(argv[++i]);
+    } else if (arg == "--report" && has_value) {
+      options.report_file = argv[++i];
+    } else {
+      cerr << "Unknown option " << arg << endl;
+      return -1;
+    }
+  }
+  if (options.sessions < 1 || options.rate <= 0) {
+    cerr << "--sessions and --rate must be positive" << endl;
+    return -1;
+  }
+
+  MapWaypoints map;
+  if (!loadMap(options.map_file, map)) {
+    cerr << "Failed to load map " << options.map_file << endl;
+    return -1;
+  }
+  map.lanes = options.lanes;
+  // Simulated time between two frames follows the send rate.
+  run.ticks_per_frame = max(1, (int)(1.0 / (options.rate * HighwaySim::TICK) + 0.5));
+
+  uWS::Hub h;
+  uv_loop_t *loop = h.getLoop();
+  uint64_t period_ms = max<uint64_t>(1, (uint64_t)(1000.0 / options.rate + 0.5));
+
+  h.onConnection([&run, period_ms](uWS::WebSocket<uWS::CLIENT> ws, uWS::HttpRequest req) {
+    LoadSession *session = static_cast<LoadSession *>(ws.getUserData());
+    session->ws.reset(new uWS::WebSocket<uWS::CLIENT>(ws));
+    session->connected = true;
+    // Stagger the sessions over one period so they don't all send at once.
+    uint64_t offset = period_ms * session->index / run.sessions.size();
+    uv_timer_start(&session->timer, sendTelemetry, offset, period_ms);
+  });
+
+  h.onMessage([&run](uWS::WebSocket<uWS::CLIENT> ws, char *data, size_t length, uWS::OpCode opCode) {
+    LoadSession *session = static_cast<LoadSession *>(ws.getUserData());
+    if (session->outstanding.empty() || !session->sim->applyControl(string(data, length))) {
+      return;
+    }
+    double latency_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - session->outstanding.front()).count();
+    run.latencies_ms.push_back(latency_ms);
+    run.responses++;
+    run.coalesced += session->outstanding.size() - 1;
+    if (latency_ms > run.options.deadline_ms) {
+      run.deadline_misses++;
+    }
+    session->outstanding.clear();
+  });
+
+  h.onDisconnection([&run](uWS::WebSocket<uWS::CLIENT> ws, int code, char *message, size_t length) {
+    LoadSession *session = static_cast<LoadSession *>(ws.getUserData());
+    if (session->connected) {
+      session->connected = false;
+      uv_timer_stop(&session->timer);
+      run.disconnects++;
+    }
+  });
+
+  h.onError([&run](void *user) {
+    run.connect_failures++;
+  });
+
+  for (int i = 0; i < options.sessions; i++) {
+    unique_ptr<LoadSession> session(new LoadSession);
+    session->index = i;
+    session->run = &run;
+    session->sim.reset(new HighwaySim(map, options.seed + i, options.vehicles));
+    uv_timer_init(loop, &session->timer);
+    session->timer.data = session.get();
+    h.connect(options.url, session.get());
+    run.sessions.push_back(move(session));
+  }
+
+  // Stop sending after the test duration and close everything, which lets
+  // the loop run out.
+  uv_timer_t stop_timer;
+  uv_timer_init(loop, &stop_timer);
+  stop_timer.data = &run;
+  uv_timer_start(&stop_timer, [](uv_timer_t *timer) {
+    LoadRun *run = static_cast<LoadRun *>(timer->data);
+    for (auto &session : run->sessions) {
+      uv_close((uv_handle_t *)&session->timer, nullptr);
+      if (session->connected) {
+        session->connected = false;
+        run->collisions += session->sim->collisions();
+        session->ws->close();
+      }
+    }
+    uv_close((uv_handle_t *)timer, nullptr);
+  }, (uint64_t)(options.duration * 1000), 0);
+
+  double cpu_before = options.server_pid ? processCpuSeconds(options.server_pid) : -1;
+  auto started = chrono::steady_clock::now();
+  h.run();
+  double wall = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+  double cpu_after = options.server_pid ? processCpuSeconds(options.server_pid) : -1;
+
+  vector<double> &l = run.latencies_ms;
+  sort(l.begin(), l.end());
+  double sum = 0;
+  for (double v : l) {
+    sum += v;
+  }
+
+  json report;
+  report["sessions"] = options.sessions;
+  report["rate_hz"] = options.rate;
+  report["duration_s"] = wall;
+  report["map"] = options.map_file;
+  report["frames_sent"] = run.frames_sent;
+  report["responses"] = run.responses;
+  report["coalesced"] = run.coalesced;
+  report["unanswered"] = run.frames_sent - run.responses - run.coalesced;
+  report["connect_failures"] = run.connect_failures;
+  report["disconnects"] = run.disconnects;
+  report["collisions"] = run.collisions;
+  report["latency_ms"] = {{"mean", l.empty() ? 0 : sum / l.size()},
+                          {"p50", percentile(l, 0.5)},
+                          {"p90", percentile(l, 0.9)},
+                          {"p99", percentile(l, 0.99)},
+                          {"p99_9", percentile(l, 0.999)},
+                          {"max", l.empty() ? 0 : l.back()}};
+  report["deadline_ms"] = options.deadline_ms;
+  report["deadline_misses"] = run.deadline_misses;
+  report["deadline_miss_ratio"] = run.responses ? (double)run.deadline_misses / run.responses : 0;
+  if (cpu_before >= 0 && cpu_after >= 0) {
+    double cpu = cpu_after - cpu_before;
+    report["server_cpu"] = {{"pid", options.server_pid},
+                            {"cpu_seconds", cpu},
+                            {"cores", wall > 0 ? cpu / wall : 0},
+                            {"cores_per_session", wall > 0 ? cpu / wall / options.sessions : 0},
+                            {"cpu_us_per_response", run.responses ? cpu * 1e6 / run.responses : 0}};
+  }
+
+  if (options.report_file.empty()) {
+    cout << report.dump(2) << endl;
+  } else {
+    ofstream(options.report_file) << report.dump(2) << endl;
+  }
+  return run.connect_failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,188 @@
+#include "metrics.h"
+#include <sstream>
+#include "alloc_counter.h"
+#include "stage_timer.h"
+
+using namespace std;
+
+namespace
+{
+	// Upper bounds (ns) of the exported latency buckets, 1us to 100ms.
+	const uint64_t LATENCY_BOUNDS_NS[] = {
+		1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+		500000, 1000000, 2500000, 5000000, 10000000, 25000000, 100000000};
+
+	void metricHeader(ostringstream &out, const char *name, const char *type, const char *help)
+	{
+		out << "# HELP " << name << " " << help << "\n";
+		out << "# TYPE " << name << " " << type << "\n";
+	}
+
+	// Writes 'h' (ns) as the cumulative buckets of a Prometheus histogram in
+	// seconds. Each HDR bucket counts against the first bound at or above its
+	// start, so a bound may include values up to one bucket width (1.6%) over.
+	void stageHistogram(ostringstream &out, const char *stage, const HdrHistogram &h)
+	{
+		const char *name = "path_planning_stage_duration_seconds";
+		size_t index = 0;
+		uint64_t cumulative = 0;
+		for (uint64_t bound : LATENCY_BOUNDS_NS)
+		{
+			for (; index < hdr::BUCKETS && hdr::lowestValueAt(index) <= bound; index++)
+			{
+				cumulative += h.countAt(index);
+			}
+			out << name << "_bucket{stage=\"" << stage << "\",le=\"" << bound / 1e9 << "\"} " << cumulative << "\n";
+		}
+		out << name << "_bucket{stage=\"" << stage << "\",le=\"+Inf\"} " << h.count() << "\n";
+		out << name << "_sum{stage=\"" << stage << "\"} " << h.sum() / 1e9 << "\n";
+		out << name << "_count{stage=\"" << stage << "\"} " << h.count() << "\n";
+	}
+}
+
+string prometheusMetrics(const WorkerPool &pool)
+{
+	ostringstream out;
+	PoolMetrics m = pool.metrics();
+
+	metricHeader(out, "path_planning_frames_received_total", "counter", "Telemetry frames received.");
+	out << "path_planning_frames_received_total " << m.frames_received << "\n";
+	metricHeader(out, "path_planning_frames_dropped_total", "counter",
+		"Telemetry frames replaced by a newer one before they were planned.");
+	out << "path_planning_frames_dropped_total " << m.frames_dropped << "\n";
+	metricHeader(out, "path_planning_cycles_total", "counter", "Planning cycles processed.");
+	out << "path_planning_cycles_total " << m.cycles_processed << "\n";
+	metricHeader(out, "path_planning_queue_delay_seconds_total", "counter",
+		"Total time frames waited for a worker.");
+	out << "path_planning_queue_delay_seconds_total " << m.queue_delay_total_us / 1e6 << "\n";
+	metricHeader(out, "path_planning_queue_delay_max_seconds", "gauge", "Longest time a frame waited for a worker.");
+	out << "path_planning_queue_delay_max_seconds " << m.queue_delay_max_us / 1e6 << "\n";
+	metricHeader(out, "path_planning_active_sessions", "gauge", "Open simulator connections.");
+	out << "path_planning_active_sessions " << m.active_sessions << "\n";
+
+	MemoryFootprint memory = processMemory();
+	metricHeader(out, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+	out << "process_resident_memory_bytes " << memory.resident_bytes << "\n";
+	metricHeader(out, "path_planning_peak_resident_memory_bytes", "gauge", "Largest resident memory size so far.");
+	out << "path_planning_peak_resident_memory_bytes " << memory.peak_resident_bytes << "\n";
+
+	if (allocationTrackingEnabled())
+	{
+		AllocationCounts allocs = allocationCounts();
+		metricHeader(out, "path_planning_allocations_total", "counter", "Heap allocations (operator new).");
+		out << "path_planning_allocations_total " << allocs.allocations << "\n";
+		metricHeader(out, "path_planning_deallocations_total", "counter", "Heap deallocations (operator delete).");
+		out << "path_planning_deallocations_total " << allocs.deallocations << "\n";
+		metricHeader(out, "path_planning_allocated_bytes_total", "counter", "Bytes requested from operator new.");
+		out << "path_planning_allocated_bytes_total " << allocs.bytes_allocated << "\n";
+		metricHeader(out, "path_planning_cycle_allocations_total", "counter",
+			"Heap allocations inside planning cycles after warm-up; anything but 0 is a regression.");
+		out << "path_planning_cycle_allocations_total " << allocs.unexpected_allocations << "\n";
+
+		ostringstream thread_bytes;
+		metricHeader(out, "path_planning_thread_allocations_total", "counter", "Heap allocations, per thread.");
+		// Threads that never named themselves (the recorder's writer, say)
+		// share one "other" series: the same labels twice fail the scrape.
+		bool any_other = false;
+		AllocationCounts other = AllocationCounts();
+		forEachThreadAllocations([&](const char *name, const AllocationCounts &counts) {
+			if (!name[0])
+			{
+				any_other = true;
+				other.allocations += counts.allocations;
+				other.bytes_allocated += counts.bytes_allocated;
+				return;
+			}
+			out << "path_planning_thread_allocations_total{thread=\"" << name << "\"} " << counts.allocations << "\n";
+			thread_bytes << "path_planning_thread_allocated_bytes_total{thread=\"" << name << "\"} "
+				<< counts.bytes_allocated << "\n";
+		});
+		if (any_other)
+		{
+			out << "path_planning_thread_allocations_total{thread=\"other\"} " << other.allocations << "\n";
+			thread_bytes << "path_planning_thread_allocated_bytes_total{thread=\"other\"} " << other.bytes_allocated
+				<< "\n";
+		}
+		metricHeader(out, "path_planning_thread_allocated_bytes_total", "counter",
+			"Bytes requested from operator new, per thread.");
+		out << thread_bytes.str();
+
+		StageAllocationTotals stage_allocs[STAGE_COUNT];
+		mergeStageAllocations(stage_allocs);
+		metricHeader(out, "path_planning_stage_allocations_total", "counter",
+			"Heap allocations made inside each stage (nested stages included).");
+		for (int i = 0; i < STAGE_COUNT; i++)
+		{
+			out << "path_planning_stage_allocations_total{stage=\"" << stageName((PlannerStage)i) << "\"} "
+				<< stage_allocs[i].allocations << "\n";
+		}
+		metricHeader(out, "path_planning_stage_allocated_bytes_total", "counter",
+			"Bytes requested from operator new inside each stage.");
+		for (int i = 0; i < STAGE_COUNT; i++)
+		{
+			out << "path_planning_stage_allocated_bytes_total{stage=\"" << stageName((PlannerStage)i) << "\"} "
+				<< stage_allocs[i].bytes << "\n";
+		}
+	}
+
+	HdrHistogram stages[STAGE_COUNT];
+	mergeStageHistograms(stages);
+	metricHeader(out, "path_planning_stage_duration_seconds", "histogram",
+		"Time spent in each stage of a telemetry to control cycle.");
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		stageHistogram(out, stageName((PlannerStage)i), stages[i]);
+	}
+
+	if (perfCountersEnabled())
+	{
+		StagePerfTotals perf[STAGE_COUNT];
+		mergeStagePerfCounters(perf);
+		metricHeader(out, "path_planning_stage_perf_events_total", "counter",
+			"Hardware performance counter totals of each stage (--perf).");
+		for (int i = 0; i < STAGE_COUNT; i++)
+		{
+			for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+			{
+				if (perfCounterAvailable((PerfCounter)c))
+				{
+					out << "path_planning_stage_perf_events_total{stage=\"" << stageName((PlannerStage)i) << "\",event=\""
+						<< perfCounterName((PerfCounter)c) << "\"} " << perf[i].values[c] << "\n";
+				}
+			}
+		}
+	}
+
+	ostringstream lanes;
+	ostringstream speeds;
+	ostringstream memory_bytes;
+	ostringstream allocations;
+	ostringstream allocated_bytes;
+	pool.forEachSession([&](const Session &session) {
+		lanes << "path_planning_session_lane{session=\"" << session.id << "\"} " << session.lane.load() << "\n";
+		speeds << "path_planning_session_speed_mph{session=\"" << session.id << "\"} " << session.speed.load() << "\n";
+		memory_bytes << "path_planning_session_memory_bytes{session=\"" << session.id << "\"} "
+			<< session.memory_bytes.load() << "\n";
+		allocations << "path_planning_session_allocations_total{session=\"" << session.id << "\"} "
+			<< session.allocations.load() << "\n";
+		allocated_bytes << "path_planning_session_allocated_bytes_total{session=\"" << session.id << "\"} "
+			<< session.allocated_bytes.load() << "\n";
+	});
+	metricHeader(out, "path_planning_session_lane", "gauge", "Lane the planner currently targets, per session.");
+	out << lanes.str();
+	metricHeader(out, "path_planning_session_speed_mph", "gauge", "Reference speed of the planner, per session.");
+	out << speeds.str();
+	metricHeader(out, "path_planning_session_memory_bytes", "gauge",
+		"Memory a session holds: its state, cycle arena and frame and message buffers.");
+	out << memory_bytes.str();
+	if (allocationTrackingEnabled())
+	{
+		metricHeader(out, "path_planning_session_allocations_total", "counter",
+			"Heap allocations of a session's planning cycles.");
+		out << allocations.str();
+		metricHeader(out, "path_planning_session_allocated_bytes_total", "counter",
+			"Bytes requested from operator new by a session's planning cycles.");
+		out << allocated_bytes.str();
+	}
+	return out.str();
+}
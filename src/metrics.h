@@ -0,0 +1,12 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include "worker_pool.h"
+
+// Renders the live counters of the server in the Prometheus text exposition
+// format (served on GET /metrics). Only reads per-thread counters and
+// histograms; nothing on the planning path waits for a scrape.
+std::string prometheusMetrics(const WorkerPool &pool);
+
+#endif // METRICS_H
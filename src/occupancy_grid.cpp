@@ -0,0 +1,48 @@
+#include "occupancy_grid.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace std;
+
+OccupancyGrid::OccupancyGrid(double length, double width)
+	: length_(length), width_(width), per_lane_(0), lanes_(0), steps_(0), origin_(0)
+{
+}
+
+void OccupancyGrid::build(const VehicleTable &vehicles, const PredictionBuffer &prediction, const LaneModel &lanes,
+	double s, int lane)
+{
+	per_lane_ = 1 / lanes.width;
+	lanes_ = lanes.count;
+	steps_ = prediction.steps;
+	origin_ = floor(s) - BEHIND;
+	bits_.assign(steps_ * lanes_ * WORDS, 0);
+
+	for (int i = 0; i < prediction.count; i++)
+	{
+		if (vehicles.predicted_s[i] < s && lanes.laneOf(vehicles.d[i]) == lane)
+		{
+			continue;
+		}
+		for (int k = 0; k < steps_; k++)
+		{
+			int first_bin;
+			int last_bin;
+			int first_lane;
+			int last_lane;
+			if (!binsAt(prediction.s(k, i), first_bin, last_bin))
+			{
+				continue;
+			}
+			lanesAt(prediction.d(k, i), first_lane, last_lane);
+			for (int l = first_lane; l <= last_lane; l++)
+			{
+				uint64_t *words = row(k, l);
+				for (int w = first_bin >> 6; w <= last_bin >> 6; w++)
+				{
+					words[w] |= rangeMask(w, first_bin, last_bin);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#ifndef OCCUPANCY_GRID_H
+#define OCCUPANCY_GRID_H
+
+#include <math.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "lane_occupancy.h"
+#include "prediction.h"
+#include "vehicle_table.h"
+
+// Which stretches of which lane the other cars cover at every prediction
+// step, around the car's own s: one bit per lane, step and 1 m of road,
+// each lane's stretch at one step packed into WORDS 64-bit words. Rebuilt
+// every frame from the predictions; whether a footprint hits anything is
+// then a handful of masked word ANDs instead of a distance check against
+// every car. Reusing an instance keeps its capacity.
+class OccupancyGrid
+{
+public:
+	static const int WORDS = 4;
+	static const int BINS = WORDS * 64;
+	// The grid covers BEHIND m behind the car's s to BINS - BEHIND m ahead.
+	static const int BEHIND = 64;
+
+	// 'length' and 'width' are the footprint of a car (m).
+	explicit OccupancyGrid(double length = 5, double width = 2);
+
+	// Rasterises the cars of 'prediction' around 's'. Cars that are behind
+	// 's' in 'lane' are left out, like in the rollouts: a car following the
+	// car has to keep its own distance.
+	void build(const VehicleTable &vehicles, const PredictionBuffer &prediction, const LaneModel &lanes, double s,
+		int lane);
+
+	int steps() const { return steps_; }
+
+	// Whether a car at 's', 'd' at step 'step' overlaps any car of the grid.
+	// Anything outside the grid's stretch of road is free. Inline: the
+	// planner asks this for every step of every candidate.
+	bool collides(int step, double s, double d) const
+	{
+		int first_bin;
+		int last_bin;
+		if (step < 0 || step >= steps_ || !binsAt(s, first_bin, last_bin))
+		{
+			return false;
+		}
+		int first_lane;
+		int last_lane;
+		lanesAt(d, first_lane, last_lane);
+		for (int l = first_lane; l <= last_lane; l++)
+		{
+			const uint64_t *words = row(step, l);
+			for (int w = first_bin >> 6; w <= last_bin >> 6; w++)
+			{
+				if (words[w] & rangeMask(w, first_bin, last_bin))
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+private:
+	// Bits first to last (inclusive) of word 'word' of a row.
+	static uint64_t rangeMask(int word, int first, int last)
+	{
+		int from = std::max(first - word * 64, 0);
+		int to = std::min(last - word * 64, 63);
+		if (from > to)
+		{
+			return 0;
+		}
+		uint64_t upto = to == 63 ? ~uint64_t(0) : (uint64_t(1) << (to + 1)) - 1;
+		return upto & ~((uint64_t(1) << from) - 1);
+	}
+
+	// Lanes a car at 'd' reaches into, as a range (lane k spans
+	// (k * width, (k + 1) * width)).
+	void lanesAt(double d, int &first, int &last) const
+	{
+		first = std::max(0, (int)floor((d - width_ / 2) * per_lane_));
+		last = std::min(lanes_ - 1, (int)floor((d + width_ / 2) * per_lane_));
+	}
+
+	// Bins of a car at 's', clipped to the grid; false if it is outside.
+	bool binsAt(double s, int &first, int &last) const
+	{
+		double from = s - length_ / 2 - origin_;
+		double to = s + length_ / 2 - origin_;
+		if (to < 0 || from >= BINS)
+		{
+			return false;
+		}
+		// from < BINS and to >= 0, so truncating is flooring where it matters
+		first = from < 0 ? 0 : (int)from;
+		last = std::min(BINS - 1, (int)to);
+		return true;
+	}
+
+	uint64_t *row(int step, int lane) { return &bits_[(step * lanes_ + lane) * WORDS]; }
+	const uint64_t *row(int step, int lane) const { return &bits_[(step * lanes_ + lane) * WORDS]; }
+
+	double length_;
+	double width_;
+	double per_lane_;  // 1 / lane width
+	int lanes_;
+	int steps_;
+	double origin_;  // s of the first bin
+	std::vector<uint64_t> bits_;
+};
+
+#endif // OCCUPANCY_GRID_H
@@ -0,0 +1,101 @@
+#include "parallel_for.h"
+#include <algorithm>
+#include <string>
+#include "alloc_counter.h"
+#include "tracer.h"
+
+using namespace std;
+
+ParallelFor::ParallelFor(size_t helpers)
+	: stopping_(false), generation_(0), open_(false), running_(0), chunk_(nullptr), body_(nullptr), count_(0), grain_(1), next_(0)
+{
+	threads_.reserve(helpers);
+	for (size_t i = 0; i < helpers; i++)
+	{
+		threads_.emplace_back([this, i]() { helper(i); });
+	}
+}
+
+ParallelFor::~ParallelFor()
+{
+	{
+		lock_guard<mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	wakeup_.notify_all();
+	for (auto &t : threads_)
+	{
+		t.join();
+	}
+}
+
+void ParallelFor::run(size_t count, size_t grain, Chunk chunk, const void *body)
+{
+	grain = max<size_t>(grain, 1);
+	unique_lock<mutex> busy(busy_, defer_lock);
+	if (threads_.empty() || count <= grain || !busy.try_lock())
+	{
+		for (size_t begin = 0; begin < count; begin += grain)
+		{
+			chunk(body, begin, min(begin + grain, count));
+		}
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(mutex_);
+		chunk_ = chunk;
+		body_ = body;
+		count_ = count;
+		grain_ = grain;
+		next_.store(0, memory_order_relaxed);
+		generation_++;
+		open_ = true;
+	}
+	wakeup_.notify_all();
+	work();
+
+	// Every chunk is taken; wait for the helpers still working on theirs.
+	unique_lock<mutex> lock(mutex_);
+	open_ = false;
+	done_.wait(lock, [this]() { return running_ == 0; });
+}
+
+void ParallelFor::work()
+{
+	for (;;)
+	{
+		size_t begin = next_.fetch_add(grain_, memory_order_relaxed);
+		if (begin >= count_)
+		{
+			return;
+		}
+		chunk_(body_, begin, min(begin + grain_, count_));
+	}
+}
+
+void ParallelFor::helper(size_t index)
+{
+	string name = "parallel for " + to_string(index);
+	setTraceThreadName(name.c_str());
+	setAllocationThreadName(name.c_str());
+	uint64_t seen = 0;
+	unique_lock<mutex> lock(mutex_);
+	for (;;)
+	{
+		wakeup_.wait(lock, [this, seen]() { return stopping_ || (open_ && generation_ != seen); });
+		if (stopping_)
+		{
+			return;
+		}
+		seen = generation_;
+		running_++;
+		lock.unlock();
+		work();
+		lock.lock();
+		if (--running_ == 0)
+		{
+			done_.notify_one();
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Helper threads for data-parallel loops inside one planning cycle. run()
+// splits [0, count) into chunks of 'grain' items that the helpers and the
+// calling thread take in turn, and returns once all of them are done.
+//
+// One loop runs at a time: a worker that calls run() while another worker's
+// loop is running does its loop alone rather than waiting, as does every
+// loop when there are no helpers. The body must not throw. Nothing is
+// allocated after construction.
+class ParallelFor
+{
+public:
+	explicit ParallelFor(size_t helpers);
+	~ParallelFor();
+	ParallelFor(const ParallelFor &) = delete;
+	ParallelFor &operator=(const ParallelFor &) = delete;
+
+	size_t helpers() const { return threads_.size(); }
+
+	// Calls body(begin, end) for consecutive ranges covering [0, count).
+	template <typename Body>
+	void run(size_t count, size_t grain, const Body &body)
+	{
+		run(count, grain, &invoke<Body>, &body);
+	}
+
+private:
+	typedef void (*Chunk)(const void *body, size_t begin, size_t end);
+
+	template <typename Body>
+	static void invoke(const void *body, size_t begin, size_t end)
+	{
+		(*static_cast<const Body *>(body))(begin, end);
+	}
+
+	void run(size_t count, size_t grain, Chunk chunk, const void *body);
+	// Takes chunks of the current loop until there are none left.
+	void work();
+	void helper(size_t index);
+
+	std::vector<std::thread> threads_;
+	// Held by the thread whose loop is running.
+	std::mutex busy_;
+
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+	std::condition_variable done_;
+	bool stopping_;
+	// Bumped for every loop; a helper joins each loop at most once.
+	uint64_t generation_;
+	// Whether helpers may still join the current loop, and how many are in it.
+	bool open_;
+	size_t running_;
+
+	// The current loop, written under 'mutex_' before it opens.
+	Chunk chunk_;
+	const void *body_;
+	size_t count_;
+	size_t grain_;
+	std::atomic<size_t> next_;
+};
+
+#endif // PARALLEL_FOR_H
@@ -0,0 +1,165 @@
+#include "perf_counters.h"
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace perf_counters
+{
+	atomic<bool> enabled(false);
+}
+
+namespace
+{
+	atomic<bool> available[PERF_COUNTER_COUNT];
+
+	// One perf_event group per thread, so that all counters are read with a
+	// single system call and are scheduled onto the PMU together.
+	struct CounterGroup
+	{
+		int leader;
+		int fds[PERF_COUNTER_COUNT];
+		int position[PERF_COUNTER_COUNT];  // index in the group read, -1 if not open
+		int opened;
+
+		CounterGroup() : leader(-1), opened(0)
+		{
+			for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+			{
+				fds[i] = -1;
+				position[i] = -1;
+			}
+		}
+
+		~CounterGroup()
+		{
+#ifdef __linux__
+			for (int fd : fds)
+			{
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+			}
+#endif
+		}
+
+		void open()
+		{
+#ifdef __linux__
+			for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+			{
+				perf_event_attr attr;
+				memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP;
+				switch (i)
+				{
+				case PERF_COUNTER_CYCLES:
+					attr.config = PERF_COUNT_HW_CPU_CYCLES;
+					break;
+				case PERF_COUNTER_INSTRUCTIONS:
+					attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+					break;
+				case PERF_COUNTER_L1D_MISSES:
+					attr.type = PERF_TYPE_HW_CACHE;
+					attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+						(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+					break;
+				case PERF_COUNTER_LLC_MISSES:
+					attr.config = PERF_COUNT_HW_CACHE_MISSES;
+					break;
+				case PERF_COUNTER_BRANCH_MISSES:
+					attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+					break;
+				case PERF_COUNTER_TASK_CLOCK:
+					attr.type = PERF_TYPE_SOFTWARE;
+					attr.config = PERF_COUNT_SW_TASK_CLOCK;
+					break;
+				}
+				int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+				if (fd < 0)
+				{
+					continue;
+				}
+				if (leader < 0)
+				{
+					leader = fd;
+				}
+				fds[i] = fd;
+				position[i] = opened++;
+			}
+#endif
+		}
+
+		bool read(PerfSample &sample) const
+		{
+#ifdef __linux__
+			uint64_t buffer[1 + PERF_COUNTER_COUNT];
+			if (leader < 0 || ::read(leader, buffer, sizeof(buffer)) < (ssize_t)(sizeof(uint64_t) * (1 + opened)))
+			{
+				return false;
+			}
+			for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+			{
+				sample.values[i] = position[i] >= 0 ? buffer[1 + position[i]] : 0;
+			}
+			return true;
+#else
+			(void)sample;
+			return false;
+#endif
+		}
+	};
+
+	CounterGroup &threadGroup()
+	{
+		static thread_local CounterGroup group;
+		static thread_local bool opened = false;
+		if (!opened)
+		{
+			group.open();
+			opened = true;
+		}
+		return group;
+	}
+}
+
+const char *perfCounterName(PerfCounter counter)
+{
+	static const char *names[PERF_COUNTER_COUNT] = {
+		"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "task_clock_ns"};
+	return counter < PERF_COUNTER_COUNT ? names[counter] : "unknown";
+}
+
+bool enablePerfCounters()
+{
+	const CounterGroup &group = threadGroup();
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+	{
+		available[i].store(group.position[i] >= 0);
+	}
+	if (group.leader < 0)
+	{
+		return false;
+	}
+	perf_counters::enabled.store(true);
+	return true;
+}
+
+bool perfCounterAvailable(PerfCounter counter)
+{
+	return available[counter].load();
+}
+
+void readPerfCounters(PerfSample &sample)
+{
+	sample.valid = threadGroup().read(sample);
+}
@@ -0,0 +1,54 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+
+// Optional hardware performance counters (Linux perf_event_open), counted in
+// user space for the calling thread. Each thread opens one counter group the
+// first time it reads while counting is enabled; a read is one read(2) call,
+// so this is for finding out why a stage is slow rather than for leaving on.
+//
+// Events the machine doesn't expose (e.g. no PMU in a VM, or
+// kernel.perf_event_paranoid > 2) are skipped and reported as unavailable.
+enum PerfCounter
+{
+	PERF_COUNTER_CYCLES,
+	PERF_COUNTER_INSTRUCTIONS,
+	PERF_COUNTER_L1D_MISSES,      // L1 data cache read misses
+	PERF_COUNTER_LLC_MISSES,      // last level cache misses
+	PERF_COUNTER_BRANCH_MISSES,
+	PERF_COUNTER_TASK_CLOCK,      // ns on the CPU (software, works without a PMU)
+	PERF_COUNTER_COUNT
+};
+
+const char *perfCounterName(PerfCounter counter);
+
+namespace perf_counters
+{
+	extern std::atomic<bool> enabled;
+}
+
+inline bool perfCountersEnabled()
+{
+	return perf_counters::enabled.load(std::memory_order_relaxed);
+}
+
+// Turns counting on for all threads; false (and left off) if not even one of
+// the events can be opened.
+bool enablePerfCounters();
+
+// Whether 'counter' could be opened (on the thread that enabled counting).
+bool perfCounterAvailable(PerfCounter counter);
+
+// Current counter values of the calling thread; 'valid' is false if its
+// counters could not be opened.
+struct PerfSample
+{
+	uint64_t values[PERF_COUNTER_COUNT];
+	bool valid;
+};
+
+void readPerfCounters(PerfSample &sample);
+
+#endif // PERF_COUNTERS_H
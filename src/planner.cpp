@@ -0,0 +1,963 @@
+#include <fstream>
+#include <math.h>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include "planner.h"
+#include "behavior_planner.h"
+#include "cubic_spline.h"
+#include "stage_timer.h"
+
+using namespace std;
+
+bool loadMap(const string &map_file, MapWaypoints &map)
+{
+	ifstream in_map_(map_file.c_str(), ifstream::in);
+	if (!in_map_.is_open())
+	{
+		return false;
+	}
+
+	string line;
+	while (getline(in_map_, line)) {
+		istringstream iss(line);
+		double x;
+		double y;
+		float s;
+		float d_x;
+		float d_y;
+		iss >> x;
+		iss >> y;
+		iss >> s;
+		iss >> d_x;
+		iss >> d_y;
+		if (!map.s.empty() && s <= map.s.back())
+		{
+			// highway_map_bosch1.csv lists its (open) track 19 times over,
+			// with s starting from 0 again each time; the first pass is the
+			// whole road.
+			break;
+		}
+		map.x.push_back(x);
+		map.y.push_back(y);
+		map.s.push_back(s);
+		map.dx.push_back(d_x);
+		map.dy.push_back(d_y);
+	}
+	if (map.x.empty())
+	{
+		return false;
+	}
+	double longest = 0;
+	for (size_t i = 1; i < map.x.size(); i++)
+	{
+		longest = max(longest, distance(map.x[i - 1], map.y[i - 1], map.x[i], map.y[i]));
+	}
+	map.closed = distance(map.x.back(), map.y.back(), map.x.front(), map.y.front()) <= longest;
+	return true;
+}
+
+double distance(double x1, double y1, double x2, double y2)
+{
+	return sqrt((x2-x1)*(x2-x1)+(y2-y1)*(y2-y1));
+}
+int ClosestWaypoint(double x, double y, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+
+	double closestLen = 100000; //large number
+	int closestWaypoint = 0;
+
+	for(size_t i = 0; i < maps_x.size(); i++)
+	{
+		double map_x = maps_x[i];
+		double map_y = maps_y[i];
+		double dist = distance(x,y,map_x,map_y);
+		if(dist < closestLen)
+		{
+			closestLen = dist;
+			closestWaypoint = i;
+		}
+
+	}
+
+	return closestWaypoint;
+
+}
+
+int NextWaypoint(double x, double y, double theta, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+
+	int closestWaypoint = ClosestWaypoint(x,y,maps_x,maps_y);
+
+	double map_x = maps_x[closestWaypoint];
+	double map_y = maps_y[closestWaypoint];
+
+	double heading = atan2( (map_y-y),(map_x-x) );
+
+	double angle = fabs(theta-heading);
+	angle = min(2*pi() - angle, angle);
+
+	if(angle > pi()/4)
+	{
+		closestWaypoint++;
+		if (closestWaypoint == (int)maps_x.size())
+		{
+			closestWaypoint = 0;
+		}
+	}
+
+	return closestWaypoint;
+
+}
+
+// Transform from Cartesian x,y coordinates to Frenet s,d coordinates
+vector<double> getFrenet(double x, double y, double theta, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+	int next_wp = NextWaypoint(x,y, theta, maps_x,maps_y);
+
+	int prev_wp;
+	prev_wp = next_wp-1;
+	if(next_wp == 0)
+	{
+		prev_wp  = maps_x.size()-1;
+	}
+
+	double n_x = maps_x[next_wp]-maps_x[prev_wp];
+	double n_y = maps_y[next_wp]-maps_y[prev_wp];
+	double x_x = x - maps_x[prev_wp];
+	double x_y = y - maps_y[prev_wp];
+
+	// find the projection of x onto n
+	double proj_norm = (x_x*n_x+x_y*n_y)/(n_x*n_x+n_y*n_y);
+	double proj_x = proj_norm*n_x;
+	double proj_y = proj_norm*n_y;
+
+	double frenet_d = distance(x_x,x_y,proj_x,proj_y);
+
+	//see if d value is positive or negative by comparing it to a center point
+
+	double center_x = 1000-maps_x[prev_wp];
+	double center_y = 2000-maps_y[prev_wp];
+	double centerToPos = distance(center_x,center_y,x_x,x_y);
+	double centerToRef = distance(center_x,center_y,proj_x,proj_y);
+
+	if(centerToPos <= centerToRef)
+	{
+		frenet_d *= -1;
+	}
+
+	// calculate s value
+	double frenet_s = 0;
+	for(int i = 0; i < prev_wp; i++)
+	{
+		frenet_s += distance(maps_x[i],maps_y[i],maps_x[i+1],maps_y[i+1]);
+	}
+
+	frenet_s += distance(0,0,proj_x,proj_y);
+
+	return {frenet_s,frenet_d};
+
+}
+
+// Transform from Frenet s,d coordinates to Cartesian x,y
+void getXY(double s, double d, const vector<double> &maps_s, const vector<double> &maps_x,
+	const vector<double> &maps_y, double &x, double &y)
+{
+	int prev_wp = -1;
+
+	while(s > maps_s[prev_wp+1] && (prev_wp < (int)(maps_s.size()-1) ))
+	{
+		prev_wp++;
+	}
+
+	int wp2 = (prev_wp+1)%maps_x.size();
+
+	double heading = atan2((maps_y[wp2]-maps_y[prev_wp]),(maps_x[wp2]-maps_x[prev_wp]));
+	// the x,y,s along the segment
+	double seg_s = (s-maps_s[prev_wp]);
+
+	double seg_x = maps_x[prev_wp]+seg_s*cos(heading);
+	double seg_y = maps_y[prev_wp]+seg_s*sin(heading);
+
+	double perp_heading = heading-pi()/2;
+
+	x = seg_x + d*cos(perp_heading);
+	y = seg_y + d*sin(perp_heading);
+
+}
+
+vector<double> getXY(double s, double d, const vector<double> &maps_s, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+	double x;
+	double y;
+	getXY(s, d, maps_s, maps_x, maps_y, x, y);
+	return {x,y};
+}
+
+namespace
+{
+	double const DIST_TOO_CLOSE_BREAK = 30; //30 or 40 meters
+	double const DIST_TOO_CLOSE_CHANGE_PATH = 40;
+	double const DIST_TO_FRONT_CAR = 40;
+	double const DIST_TO_BACK_CAR = 5;
+	double const NO_CAR = 9999; //Max distance
+
+	// Narrows the gaps to the nearest cars of 'lane' that are more than
+	// DIST_TO_BACK_CAR behind and DIST_TO_FRONT_CAR ahead of car_s, or sets
+	// both to 0 if a car is closer than that.
+	template <int LANES>
+	void laneGaps(const LaneOccupancy<LANES> &lanes, int lane, double car_s, double &front_dist, double &back_dist)
+	{
+		if (lanes.occupied(lane, car_s, DIST_TO_BACK_CAR, DIST_TO_FRONT_CAR))
+		{
+			front_dist = 0;
+			back_dist = 0;
+			return;
+		}
+		double gap;
+		if (lanes.leader(lane, car_s, DIST_TO_FRONT_CAR, gap) >= 0 && gap < front_dist)
+		{
+			front_dist = gap;
+		}
+		if (lanes.follower(lane, car_s, DIST_TO_BACK_CAR, gap) >= 0 && gap < back_dist)
+		{
+			back_dist = gap;
+		}
+	}
+
+	// The lane to change to from 'lane', which has a slow car ahead: one of
+	// the neighbouring lanes, preferring the left one, an empty one and then
+	// the one with more space ahead; 'lane' itself if cars are too near in
+	// all of them.
+	template <int LANES>
+	int chooseLane(const LaneOccupancy<LANES> &lanes, int lane_count, int lane, double car_s)
+	{
+		int candidates[2];
+		double front_dist[2];
+		double back_dist[2];
+		int n = 0;
+		if (lane > 0)
+		{
+			candidates[n++] = lane - 1;
+		}
+		if (lane + 1 < lane_count)
+		{
+			candidates[n++] = lane + 1;
+		}
+		if (n == 0)
+		{
+			return lane;
+		}
+
+		bool all_empty = true;
+		bool all_blocked = true;
+		for (int c = 0; c < n; c++)
+		{
+			front_dist[c] = NO_CAR;
+			back_dist[c] = NO_CAR;
+			laneGaps(lanes, candidates[c], car_s, front_dist[c], back_dist[c]);
+			all_empty = all_empty && front_dist[c] == NO_CAR && back_dist[c] == NO_CAR;
+			all_blocked = all_blocked && front_dist[c] == 0 && back_dist[c] == 0;
+		}
+		if (all_empty)
+		{
+			return candidates[0]; // if there is no car in the neighbouring lanes then turn to left
+		}
+		if (all_blocked)
+		{
+			return lane; // if there cars very near in the neighbouring lanes then do not turn
+		}
+		for (int c = 0; c < n; c++)
+		{
+			if (front_dist[c] == NO_CAR && back_dist[c] == NO_CAR)
+			{
+				return candidates[c]; // if there is no car in this lane
+			}
+		}
+		if (n == 1 || front_dist[0] > front_dist[1])
+		{
+			return candidates[0]; // if other cars are at safe distance, or more space on left side
+		}
+		return candidates[1]; // More space on right side
+	}
+
+	// The lanes of the other cars, for a road of LANES lanes. Reused from
+	// cycle to cycle, so that only the first builds on a thread allocate.
+	template <int LANES>
+	LaneOccupancy<LANES> &laneOccupancy()
+	{
+		static thread_local LaneOccupancy<LANES> lanes;
+		return lanes;
+	}
+
+	// Looks through the cars in 'lane', from the 'first' on, for one close
+	// enough to slow down for. If 'may_change' it stops at the first car
+	// close enough to change lanes for and leaves its index in 'trigger',
+	// which is -1 otherwise.
+	template <int LANES>
+	bool scanLane(const LaneOccupancy<LANES> &lanes, const VehicleTable &vehicles, int lane, double car_s, bool may_change,
+		int first, int &trigger)
+	{
+		bool accident_possible = false;
+		trigger = -1;
+		for (int i = first; i < (int)vehicles.size(); i++)
+		{
+			if (lanes.laneOf(i) == lane) // if car is in lane 1, lane width is from 4m to 8m
+			{
+				// If other car is in the same lane as of our car then check the speed of the other car
+				double other_car_s = vehicles.predicted_s[i];  // the car's future s value, at the end of the previous path
+
+				if ((other_car_s > car_s) && ((other_car_s - car_s) < DIST_TOO_CLOSE_BREAK))  // If Other car's future s value is greater than our car's future s value and distance between them is less than 30m then take action
+				{
+					accident_possible = true; // flag to reduce the speed and possibly change the lanes 
+				}
+				if (may_change && (other_car_s > car_s) && ((other_car_s - car_s) < DIST_TOO_CLOSE_CHANGE_PATH))
+				{
+					trigger = i;
+					break;
+				}
+			}
+		}
+		return accident_possible;
+	}
+
+	// Sorts the other cars into lanes and looks for a car ahead in the car's
+	// lane: returns whether one is close enough to slow down for, and in
+	// 'trigger' the first one within DIST_TOO_CLOSE_CHANGE_PATH if the car
+	// may change lanes (at most every 5 seconds), -1 if none is.
+	template <int LANES>
+	bool scanTraffic(const Telemetry &telemetry, const LaneModel &model, double car_s, PlannerState &state, int &trigger)
+	{
+		LaneOccupancy<LANES> &lanes = laneOccupancy<LANES>();
+		// Sensor Fusion Data, a list of all other cars on the same side of the road.
+		const VehicleTable &vehicles = telemetry.vehicles;
+		lanes.build(vehicles, model);
+		const bool may_change = std::chrono::duration_cast<std::chrono::microseconds>(telemetry.received - state.lane_changed).count() > 5000000;
+		return scanLane(lanes, vehicles, state.lane, car_s, may_change, 0, trigger);
+	}
+
+	// Changes lanes for the car at 'trigger' (see scanTraffic()) if a
+	// neighbouring lane has room, and goes on with the scan of the cars after
+	// it in the lane the car ends up in: returns whether one of those is close
+	// enough to slow down for.
+	template <int LANES>
+	bool changeLane(const Telemetry &telemetry, const LaneModel &model, double car_s, PlannerState &state, int trigger)
+	{
+		const LaneOccupancy<LANES> &lanes = laneOccupancy<LANES>();
+		const int lane_count = LANES == DYNAMIC_LANES ? model.count : LANES;
+		// Define the logic for change of lane:
+		int target = chooseLane(lanes, lane_count, state.lane, car_s);
+		if (target != state.lane)
+		{
+			state.lane = target;
+			state.lane_changed = telemetry.received;
+		}
+		// The scan only triggers once a cycle: either the car just changed
+		// lanes, or the same lanes would be weighed again.
+		int next;
+		return scanLane(lanes, telemetry.vehicles, state.lane, car_s, false, trigger + 1, next);
+	}
+
+	// What the behavior planner sees of the other cars, shared by the
+	// rollouts of all candidates. Reused from cycle to cycle, so that only
+	// the first builds on a thread allocate.
+	struct TrafficPicture
+	{
+		PredictionBuffer prediction;
+		SweptCollisionChecker collisions;
+		OccupancyGrid occupancy;
+	};
+
+	TrafficPicture &trafficPicture()
+	{
+		static thread_local TrafficPicture traffic;
+		return traffic;
+	}
+
+	// Tracks and predicts the other cars and lays them out for the collision
+	// checks that 'options' select.
+	void trackTraffic(const BehaviorOptions &options, const Telemetry &telemetry, const LaneModel &model, double car_s,
+		PlannerState &state, TrafficPicture &traffic)
+	{
+		state.tracker.update(telemetry.vehicles, telemetry.received, model);
+		state.tracker.predict(telemetry.vehicles, telemetry.previous_path_x.size() * POINT_INTERVAL, options.steps,
+			options.horizon / options.steps, model, traffic.prediction);
+		if (options.collisions == COLLISION_SWEPT)
+		{
+			traffic.collisions.build(telemetry.vehicles, traffic.prediction, model, car_s, state.lane);
+		}
+		else
+		{
+			traffic.occupancy.build(telemetry.vehicles, traffic.prediction, model, car_s, state.lane);
+		}
+	}
+
+	// Lets 'behavior' choose lane and target speed from the picture
+	// trackTraffic() took; returns the target speed (mph).
+	double followBehavior(const BehaviorPlanner &behavior, const Telemetry &telemetry, const LaneModel &model, double car_s,
+		double max_speed, const TrafficPicture &traffic, PlannerState &state)
+	{
+		const std::chrono::steady_clock::time_point now = telemetry.received;
+		const BehaviorOptions &options = behavior.options();
+
+		BehaviorContext context;
+		context.vehicles = &telemetry.vehicles;
+		context.lanes = &model;
+		context.lane = state.lane;
+		context.s = car_s;
+		context.speed = state.current_car_speed / 2.24;  // mph to m/s
+		context.speed_limit = max_speed / 2.24;
+		context.may_change_lane = std::chrono::duration_cast<std::chrono::microseconds>(now - state.lane_changed).count() > 5000000;
+		context.prediction = &traffic.prediction;
+		context.collisions = options.collisions == COLLISION_SWEPT ? &traffic.collisions : nullptr;
+		context.occupancy = options.collisions == COLLISION_GRID ? &traffic.occupancy : nullptr;
+		Maneuver chosen = behavior.choose(context);
+		if (chosen.lane != state.lane)
+		{
+			state.lane = chosen.lane;
+			state.lane_changed = now;
+		}
+		return chosen.speed * 2.24;
+	}
+
+	// Gap the speed profile keeps to the car ahead (m), and how far the
+	// previous path's last step may be off the profile's speed (m/s) for the
+	// path to count as one the profile made.
+	const double PROFILE_MIN_GAP = 15;
+	const double PROFILE_MISMATCH = 2;
+
+	// Steps the speed towards 'target' as the rules would.
+	void stepTowards(double target, double max_speed, double &current_car_speed)
+	{
+		if (current_car_speed > target)
+		{
+			current_car_speed = max(target, current_car_speed - 0.224);
+		}
+		else if (current_car_speed < target)
+		{
+			current_car_speed = min(target, current_car_speed + (current_car_speed < max_speed - 10 ? 0.224 * 1.5 : 0.224));
+		}
+	}
+
+	// Distance to the nearest car ahead of 'car_s' in 'lane' and its speed,
+	// both at the end of the previous path; false if there is none.
+	bool leaderAhead(const VehicleTable &vehicles, const LaneModel &lanes, int lane, double car_s, double &gap,
+		double &speed)
+	{
+		bool found = false;
+		for (size_t i = 0; i < vehicles.size(); i++)
+		{
+			double ahead = vehicles.predicted_s[i] - car_s;
+			if (ahead > 0 && (!found || ahead < gap) && lanes.laneOf(vehicles.d[i]) == lane)
+			{
+				gap = ahead;
+				speed = vehicles.speed[i];
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	// Where the car is in its speed profile at the end of the previous path:
+	// the state the last path ended in if the previous path still ends at
+	// that speed, else the speed of its last step (or of the car).
+	SpeedState profileStart(const Telemetry &telemetry, const PlannerState &state)
+	{
+		const vector<double> &previous_path_x = telemetry.previous_path_x;
+		const vector<double> &previous_path_y = telemetry.previous_path_y;
+		const int prev_size = previous_path_x.size();
+		if (prev_size < 2)
+		{
+			return SpeedState{telemetry.speed / 2.24, 0};
+		}
+		double step = distance(previous_path_x[prev_size - 2], previous_path_y[prev_size - 2],
+			previous_path_x[prev_size - 1], previous_path_y[prev_size - 1]) / POINT_INTERVAL;
+		if (fabs(step - state.profile.speed) < PROFILE_MISMATCH)
+		{
+			return state.profile;
+		}
+		return SpeedState{step, 0};
+	}
+
+	// Horizon of the jerk minimising trajectories (s), the end speeds tried
+	// between the current and the target speed, and the peaks a trajectory
+	// may have to be taken.
+	const double JMT_HORIZON = 3;
+	const int JMT_SPEED_CANDIDATES = 7;
+	const double JMT_MAX_ACCELERATION = 9;  // m/s^2
+	const double JMT_MAX_JERK = 9;          // m/s^3
+
+	// The road around one stretch of s as smooth functions of s: splines of
+	// x, y and the normal through the nearby waypoints, so that Frenet to
+	// Cartesian has no kinks at the waypoints the way getXY() has. On a
+	// closed map s may run past the end of the track and the waypoints are
+	// unwrapped to meet it; on an open one the stretch stops at the ends of
+	// the map and the road is extrapolated beyond them.
+	class LocalRoad
+	{
+	public:
+		void fit(const MapWaypoints &map, double track_length, double s)
+		{
+			const int n = map.s.size();
+			const int points = min(n, (int)CubicSpline::MAX_POINTS);
+			double lap = 0;
+			if (map.closed)
+			{
+				lap = floor(s / track_length) * track_length;
+			}
+			else
+			{
+				s = min(max(s, map.s.front()), map.s.back());
+			}
+			int i = (int)(upper_bound(map.s.begin(), map.s.end(), s - lap) - map.s.begin()) - 1;
+			// two waypoints behind s, the rest ahead
+			int first = i - 2;
+			if (!map.closed)
+			{
+				first = max(0, min(first, n - points));
+			}
+			double ss[CubicSpline::MAX_POINTS];
+			double xs[CubicSpline::MAX_POINTS];
+			double ys[CubicSpline::MAX_POINTS];
+			double dxs[CubicSpline::MAX_POINTS];
+			double dys[CubicSpline::MAX_POINTS];
+			for (int k = 0; k < points; k++)
+			{
+				int j = first + k;
+				double offset = lap;
+				while (j < 0)
+				{
+					j += n;
+					offset -= track_length;
+				}
+				while (j >= n)
+				{
+					j -= n;
+					offset += track_length;
+				}
+				ss[k] = map.s[j] + offset;
+				xs[k] = map.x[j];
+				ys[k] = map.y[j];
+				dxs[k] = map.dx[j];
+				dys[k] = map.dy[j];
+			}
+			x_.set_points(ss, xs, points);
+			y_.set_points(ss, ys, points);
+			dx_.set_points(ss, dxs, points);
+			dy_.set_points(ss, dys, points);
+		}
+
+		void toXY(double s, double d, double &x, double &y) const
+		{
+			double nx = dx_(s);
+			double ny = dy_(s);
+			double norm = sqrt(nx * nx + ny * ny);
+			x = x_(s) + d * nx / norm;
+			y = y_(s) + d * ny / norm;
+		}
+
+	private:
+		CubicSpline x_;
+		CubicSpline y_;
+		CubicSpline dx_;
+		CubicSpline dy_;
+	};
+
+	// s from the first waypoint back round to itself, on a closed map.
+	double trackLength(const MapWaypoints &map)
+	{
+		return map.s.back() + distance(map.x.back(), map.y.back(), map.x.front(), map.y.front());
+	}
+
+	// A jerk minimising path for the next cycle: where it starts, the
+	// quintics in s and d it follows from there, and the road to lay them on.
+	struct JmtPath
+	{
+		LocalRoad road;
+		Quintic s;
+		Quintic d;
+	};
+
+	// Plans 'path' from the end of the previous path towards the centre of
+	// 'lane' at 'speed' (mph): of a few end speeds between the current and
+	// the target one, the quickest whose peaks stay within
+	// JMT_MAX_ACCELERATION and JMT_MAX_JERK, else the gentlest.
+	void planJmt(const Telemetry &telemetry, const PlannerState &state, const MapWaypoints &map, int lane, double speed,
+		JmtPath &path)
+	{
+		const double track_length = trackLength(map);
+		const vector<double> &previous_path_x = telemetry.previous_path_x;
+		const vector<double> &previous_path_y = telemetry.previous_path_y;
+		const int prev_size = previous_path_x.size();
+		JmtBoundary start_s;
+		JmtBoundary start_d;
+		bool continued = false;
+		if (prev_size >= 2 && state.end_known)
+		{
+			// Continue from where the last path was planned to end, provided
+			// that is where the previous path does end. (end_path_s is no
+			// help there: getFrenet() is metres off near waypoints.)
+			path.road.fit(map, track_length, state.end_s.x);
+			double x;
+			double y;
+			path.road.toXY(state.end_s.x, state.end_d.x, x, y);
+			continued = distance(x, y, previous_path_x[prev_size - 1], previous_path_y[prev_size - 1]) < 0.5;
+			start_s = state.end_s;
+			start_d = state.end_d;
+		}
+		if (!continued && prev_size >= 2)
+		{
+			// A previous path this planner did not make: its end, at the
+			// speed of its last step.
+			double step = distance(previous_path_x[prev_size - 2], previous_path_y[prev_size - 2],
+				previous_path_x[prev_size - 1], previous_path_y[prev_size - 1]);
+			start_s = JmtBoundary{telemetry.end_path_s, step / POINT_INTERVAL, 0};
+			start_d = JmtBoundary{telemetry.end_path_d, 0, 0};
+		}
+		else if (!continued)
+		{
+			start_s = JmtBoundary{telemetry.s, telemetry.speed / 2.24, 0};
+			start_d = JmtBoundary{telemetry.d, 0, 0};
+		}
+		if (!continued)
+		{
+			path.road.fit(map, track_length, start_s.x);
+		}
+
+		JmtBoundary starts[JMT_SPEED_CANDIDATES + 1];
+		JmtBoundary ends[JMT_SPEED_CANDIDATES + 1];
+		Quintic quintics[JMT_SPEED_CANDIDATES + 1];
+		const double target = speed / 2.24;
+		for (int k = 0; k < JMT_SPEED_CANDIDATES; k++)
+		{
+			double v = start_s.v + (target - start_s.v) * (k + 1) / JMT_SPEED_CANDIDATES;
+			starts[k] = start_s;
+			ends[k] = JmtBoundary{start_s.x + (start_s.v + v) / 2 * JMT_HORIZON, v, 0};
+		}
+		starts[JMT_SPEED_CANDIDATES] = start_d;
+		ends[JMT_SPEED_CANDIDATES] = JmtBoundary{map.lanes.center(lane), 0, 0};
+		solveJmt(starts, ends, JMT_SPEED_CANDIDATES + 1, JMT_HORIZON, quintics);
+
+		int chosen = 0;
+		for (int k = JMT_SPEED_CANDIDATES - 1; k > 0; k--)
+		{
+			double acceleration;
+			double jerk;
+			peakAccelerationJerk(quintics[k], JMT_HORIZON, 15, acceleration, jerk);
+			if (acceleration <= JMT_MAX_ACCELERATION && jerk <= JMT_MAX_JERK)
+			{
+				chosen = k;
+				break;
+			}
+		}
+		path.s = quintics[chosen];
+		path.d = quintics[JMT_SPEED_CANDIDATES];
+	}
+
+	// Appends the points of 'path' that fill the trajectory up to
+	// PATH_POINTS, and remembers where they end.
+	void emitJmt(const JmtPath &path, const MapWaypoints &map, PlannerState &state, Trajectory &trajectory)
+	{
+		const int n = PATH_POINTS - (int)trajectory.x.size();
+		if (n <= 0)
+		{
+			return;
+		}
+		double s[PATH_POINTS];
+		double d[PATH_POINTS];
+		samplePositions(path.s, POINT_INTERVAL, POINT_INTERVAL, n, s);
+		samplePositions(path.d, POINT_INTERVAL, POINT_INTERVAL, n, d);
+		for (int i = 0; i < n; i++)
+		{
+			double x;
+			double y;
+			path.road.toXY(s[i], d[i], x, y);
+			trajectory.x.push_back(x);
+			trajectory.y.push_back(y);
+		}
+		state.end_s = path.s.boundary(n * POINT_INTERVAL);
+		if (map.closed)
+		{
+			state.end_s.x = fmod(state.end_s.x, trackLength(map));
+		}
+		state.end_d = path.d.boundary(n * POINT_INTERVAL);
+		state.end_known = true;
+	}
+}
+
+void plan(const Telemetry &telemetry, PlannerState &state, const MapWaypoints &map, Trajectory &trajectory,
+	const PlannerOptions &options)
+{
+	double const MAX_SPEED = 49.70;
+
+	PLANNER_STAGE_LAPS(stages);
+
+	double &current_car_speed = state.current_car_speed;
+	int &lane = state.lane;
+	vector<double> &next_x_vals = trajectory.x;
+	vector<double> &next_y_vals = trajectory.y;
+	const vector<double> &map_waypoints_x = map.x;
+	const vector<double> &map_waypoints_y = map.y;
+	const vector<double> &map_waypoints_s = map.s;
+
+	// Main car's localization Data
+	double car_x = telemetry.x;
+	double car_y = telemetry.y;
+	double car_s = telemetry.s;
+	double car_yaw = telemetry.yaw;
+
+	// Previous path data given to the Planner
+	const vector<double> &previous_path_x = telemetry.previous_path_x;
+	const vector<double> &previous_path_y = telemetry.previous_path_y;
+	// Previous path's end s value
+	double end_path_s = telemetry.end_path_s;
+
+	// TODO: define a path made up of (x,y) points that the car will visit sequentially every .02 seconds
+	/*
+	double dist_inc = 0.3;  // controls speed limit
+	for (int i = 0; i < 50; i++)
+	{
+		double next_s = car_s + (i + 1)* dist_inc;
+		double next_d = 6;
+		vector<double> xy = getXY(next_s, next_d, map_waypoints_s, map_waypoints_x, map_waypoints_y);
+
+		next_x_vals.push_back(xy[0]);  //car_x +(dist_inc*i)*cos(deg2rad(car_yaw))
+		next_y_vals.push_back(xy[1]);  //car_y + (dist_inc*i)*sin(deg2rad(car_yaw))
+	}
+	*/
+	//New Logic
+
+	int prev_size = previous_path_x.size(); // capture the size of a previous path
+
+	if (prev_size > 0)
+	{
+		car_s = end_path_s;
+	}
+	if (lane >= map.lanes.count)
+	{
+		lane = map.lanes.count - 1; // a road narrower than the lane the state started in
+	}
+	double target_speed = MAX_SPEED;  // mph, for the speed profile
+	bool accident_possible = false;
+	int trigger = -1;
+	bool (*change_lane)(const Telemetry &, const LaneModel &, double, PlannerState &, int) = nullptr;
+	if (options.behavior)
+	{
+		trackTraffic(options.behavior->options(), telemetry, map.lanes, car_s, state, trafficPicture());
+	}
+	else
+	{
+		switch (options.dynamic_lanes ? DYNAMIC_LANES : map.lanes.count)
+		{
+		case 2:
+			accident_possible = scanTraffic<2>(telemetry, map.lanes, car_s, state, trigger);
+			change_lane = changeLane<2>;
+			break;
+		case 3:
+			accident_possible = scanTraffic<3>(telemetry, map.lanes, car_s, state, trigger);
+			change_lane = changeLane<3>;
+			break;
+		case 4:
+			accident_possible = scanTraffic<4>(telemetry, map.lanes, car_s, state, trigger);
+			change_lane = changeLane<4>;
+			break;
+		default:
+			accident_possible = scanTraffic<DYNAMIC_LANES>(telemetry, map.lanes, car_s, state, trigger);
+			change_lane = changeLane<DYNAMIC_LANES>;
+			break;
+		}
+	}
+
+	PLANNER_STAGE_LAP(stages, STAGE_SENSOR_FUSION);
+
+	if (options.behavior)
+	{
+		target_speed = followBehavior(*options.behavior, telemetry, map.lanes, car_s, MAX_SPEED, trafficPicture(), state);
+		if (options.speed == SPEED_STEPS)
+		{
+			stepTowards(target_speed, MAX_SPEED, current_car_speed);
+		}
+	}
+	else
+	{
+		if (trigger >= 0)
+		{
+			accident_possible = change_lane(telemetry, map.lanes, car_s, state, trigger) || accident_possible;
+		}
+
+		// (A speed profile slows down for the car ahead by itself.)
+		if (options.speed == SPEED_STEPS && accident_possible)
+		{
+			current_car_speed = current_car_speed - 0.224; // 0.5 miles/hour is 0.224 meter/second 
+		}
+		else if (options.speed == SPEED_STEPS && current_car_speed < MAX_SPEED)
+		{
+			if (current_car_speed < MAX_SPEED-10)
+			{
+				current_car_speed = current_car_speed + 0.224*1.5; // 0.5 miles/hour is 0.224 meter/second 
+			}
+			else
+			{
+				current_car_speed = current_car_speed + 0.224; // 0.5 miles/hour is 0.224 meter/second 
+			}
+			
+		}
+	}
+
+	if (options.speed == SPEED_PROFILE)
+	{
+		double gap = 0;
+		double leader_speed = 0;
+		if (leaderAhead(telemetry.vehicles, map.lanes, lane, car_s, gap, leader_speed))
+		{
+			target_speed = min(target_speed, followingSpeed(gap, leader_speed, PROFILE_MIN_GAP, options.speed_limits) * 2.24);
+		}
+	}
+
+	PLANNER_STAGE_LAP(stages, STAGE_LANE_DECISION);
+
+	if (options.generator == PATH_JMT)
+	{
+		// The quintics limit acceleration and jerk themselves; with a
+		// profile they head straight for the target.
+		JmtPath path;
+		planJmt(telemetry, state, map, lane, options.speed == SPEED_PROFILE ? target_speed : current_car_speed, path);
+		PLANNER_STAGE_LAP(stages, STAGE_SPLINE_FIT);
+
+		next_x_vals.assign(previous_path_x.begin(), previous_path_x.end());
+		next_y_vals.assign(previous_path_y.begin(), previous_path_y.end());
+		emitJmt(path, map, state, trajectory);
+		if (options.speed == SPEED_PROFILE)
+		{
+			current_car_speed = state.end_s.v * 2.24;
+		}
+		PLANNER_STAGE_LAP(stages, STAGE_POINT_GENERATION);
+		return;
+	}
+
+	//create a list of widely spaced (x,y) waypoints, evenly spaced at 30m, these waypoints are interpolated with Spline
+	double ptsx[5];
+	double ptsy[5];
+	int pts = 0;
+
+	//Get the starting point or previous path end points of a car
+	double source_x = car_x;
+	double source_y = car_y;
+	double source_yaw = deg2rad(car_yaw);
+
+	if (prev_size < 2)  // If prev size is almost empty, use car as starting reference
+	{
+		//Use points that make the path tangent to the Car, makes calculations easy
+		double prev_car_x = car_x - cos(source_yaw);
+		double prev_car_y = car_y - sin(source_yaw);
+
+		ptsx[pts] = prev_car_x;
+		ptsy[pts++] = prev_car_y;
+
+		ptsx[pts] = car_x;
+		ptsy[pts++] = car_y;
+
+	}
+	else  // use the prev path's endpoints as starting reference
+	{
+
+		source_x = previous_path_x[prev_size - 1];
+		source_y = previous_path_y[prev_size - 1];
+
+		double source_x_prev = previous_path_x[prev_size - 2];
+		double source_y_prev = previous_path_y[prev_size - 2];
+		source_yaw = atan2(source_y - source_y_prev, source_x - source_x_prev);
+
+		//Use points that make the path tangent to the previous path's end points
+		ptsx[pts] = source_x_prev;
+		ptsy[pts++] = source_y_prev;
+
+		ptsx[pts] = source_x;
+		ptsy[pts++] = source_y;
+	}
+	 
+	//In Frenet, add 30m spaced points ahead of starting reference
+	for (int ahead = 30; ahead <= 90; ahead += 30)
+	{
+		getXY(car_s + ahead, map.lanes.center(lane), map_waypoints_s, map_waypoints_x, map_waypoints_y, ptsx[pts], ptsy[pts]);
+		pts++;
+	}
+
+	for (int i = 0; i < pts; i++)
+	{
+		//Change the coordinate system, shift car reference angle to 0 degrees
+		double shift_x = ptsx[i] - source_x;
+		double shift_y = ptsy[i] - source_y;
+
+		//Apply Rotation
+		ptsx[i] = (shift_x * cos(0 - source_yaw) - shift_y  * sin(0 - source_yaw));
+		ptsy[i] = (shift_x * sin(0 - source_yaw) + shift_y  * cos(0 - source_yaw));
+	}
+
+	//create a spline
+	CubicSpline s;
+	s.set_points(ptsx, ptsy, pts);   // anchor points / Far spaced waypoints
+	PLANNER_STAGE_LAP(stages, STAGE_SPLINE_FIT);
+
+	//define the points to be used for planner
+	next_x_vals.clear();
+	next_y_vals.clear();
+
+	//start with all of the previous path points
+	for (size_t i = 0; i < previous_path_x.size(); i++)
+	{
+		next_x_vals.push_back(previous_path_x[i]);
+		next_y_vals.push_back(previous_path_y[i]);
+	}
+
+	//calculate how to break up spline points to travel at desired velocity
+	double target_x = 30.0;  // define total distance d
+	double target_y = s(target_x);  // spline function gives y for each x value
+	double target_dist = sqrt(target_x * target_x + target_y * target_y);
+	double x_addition = 0;  // increment x along the spline distance
+
+	// With a speed profile, the distance along the path after every new
+	// point, from where the profile was at the end of the previous path.
+	double covered[PATH_POINTS];
+	const int new_points = PATH_POINTS - prev_size;
+	if (options.speed == SPEED_PROFILE && new_points > 0)
+	{
+		SpeedState profile = profileStart(telemetry, state);
+		sampleProfile(profile, target_speed / 2.24, POINT_INTERVAL, new_points, options.speed_limits, covered);
+		state.profile = profile;
+		current_car_speed = profile.speed * 2.24;
+	}
+
+	//fill up rest of the path planner after filling it with previou points, always 50 points below
+	for (int i = 1; i <= new_points; i++)
+	{
+		double x_point;
+		if (options.speed == SPEED_PROFILE)
+		{
+			x_point = covered[i - 1] * target_x / target_dist;
+		}
+		else
+		{
+			double N = target_dist / (0.02 * current_car_speed / 2.24);  // distance = N * 0.02 * Velocity, 5 miles per hour is 2.24 meter/second
+			x_point = x_addition + target_x / N;
+		}
+		double y_point = s(x_point);
+		x_addition = x_point;
+
+		double x_ref = x_point;
+		double y_ref = y_point;
+
+		//rotate back to normal after rotating it earlier, change coordinate system to global coordinates
+		x_point = x_ref * cos(source_yaw) - y_ref * sin(source_yaw);
+		y_point = x_ref * sin(source_yaw) + y_ref * cos(source_yaw);
+
+		x_point += source_x;
+		y_point += source_y;
+
+		next_x_vals.push_back(x_point);
+		next_y_vals.push_back(y_point);
+	}
+	
+	PLANNER_STAGE_LAP(stages, STAGE_POINT_GENERATION);
+	//New Logic - End
+}
@@ -0,0 +1,179 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "jmt.h"
+#include "lane_occupancy.h"
+#include "prediction.h"
+#include "vehicle_table.h"
+#include "velocity_profile.h"
+
+// For converting back and forth between radians and degrees.
+constexpr double pi() { return M_PI; }
+inline double deg2rad(double x) { return x * pi() / 180; }
+inline double rad2deg(double x) { return x * 180 / pi(); }
+
+// Waypoint map: x,y,s and d normalized normal vectors of every waypoint.
+struct MapWaypoints
+{
+	std::vector<double> x;
+	std::vector<double> y;
+	std::vector<double> s;
+	std::vector<double> dx;
+	std::vector<double> dy;
+	// The road's lanes; not part of the waypoint file, the simulator's
+	// three 4 m lanes unless set otherwise (--lanes and --lane-width).
+	LaneModel lanes;
+	// Whether the last waypoint leads back to the first, so that s wraps
+	// around the track; set by loadMap().
+	bool closed = false;
+};
+
+// Loads a whitespace separated "x y s dx dy" waypoint file, up to the first
+// waypoint whose s does not increase: the planner needs s sorted, and a map
+// that starts over from s = 0 only repeats itself. The map counts as closed
+// if its last waypoint is no farther from the first than consecutive
+// waypoints are from each other.
+// Returns false if the file could not be opened or holds no waypoints.
+bool loadMap(const std::string &map_file, MapWaypoints &map);
+
+double distance(double x1, double y1, double x2, double y2);
+int ClosestWaypoint(double x, double y, const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+int NextWaypoint(double x, double y, double theta, const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+
+// Transform from Cartesian x,y coordinates to Frenet s,d coordinates
+std::vector<double> getFrenet(double x, double y, double theta, const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+
+// Transform from Frenet s,d coordinates to Cartesian x,y
+std::vector<double> getXY(double s, double d, const std::vector<double> &maps_s, const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+// Same, without allocating the result
+void getXY(double s, double d, const std::vector<double> &maps_s, const std::vector<double> &maps_x,
+	const std::vector<double> &maps_y, double &x, double &y);
+
+// Number of points handed to the simulator every cycle.
+const int PATH_POINTS = 50;
+// Seconds between two points of a path.
+const double POINT_INTERVAL = 0.02;
+
+// The data object of one "telemetry" event, decoded (see protocol.h).
+// Reusing an instance keeps the capacity of its vectors from cycle to cycle.
+struct Telemetry
+{
+	// Sized for a full previous path and the dozen cars the simulator
+	// reports, so that the first cycles don't grow them one by one.
+	Telemetry()
+	{
+		previous_path_x.reserve(PATH_POINTS);
+		previous_path_y.reserve(PATH_POINTS);
+		vehicles.reserve(32);
+	}
+
+	std::chrono::steady_clock::time_point received;
+
+	// Main car's localization Data
+	double x;
+	double y;
+	double s;
+	double d;
+	double yaw;    // degrees
+	double speed;  // mph
+
+	// Previous path data given to the Planner, and its end s and d values
+	std::vector<double> previous_path_x;
+	std::vector<double> previous_path_y;
+	double end_path_s;
+	double end_path_d;
+
+	// Sensor Fusion Data, a list of all other cars on the same side of the
+	// road. predicted_s is where each car will be when the car reaches the
+	// end of previous_path_x.
+	VehicleTable vehicles;
+};
+
+// The (x,y) points the car should visit every .02 seconds.
+struct Trajectory
+{
+	std::vector<double> x;
+	std::vector<double> y;
+
+	Trajectory()
+	{
+		x.reserve(PATH_POINTS);
+		y.reserve(PATH_POINTS);
+	}
+};
+
+// Everything the planner remembers between two telemetry messages of one
+// simulator session.
+struct PlannerState
+{
+	//Define the current speed of the car
+	double current_car_speed = 0.0;
+	//lane variable drives the logic of changing the lanes
+	int lane = 1;
+	std::chrono::steady_clock::time_point lane_changed;
+	// Where the path sent last ends, along and across the road; the JMT
+	// generator continues from there.
+	JmtBoundary end_s{0, 0, 0};
+	JmtBoundary end_d{0, 0, 0};
+	bool end_known = false;
+	// Histories of the other cars, for the cost-function planner's
+	// predictions.
+	VehicleTracker tracker;
+	// Where the speed profile is at the end of the path sent last.
+	SpeedState profile{0, 0};
+
+	explicit PlannerState(std::chrono::steady_clock::time_point started) : lane_changed(started) {}
+};
+
+class BehaviorPlanner;
+
+// How the new points of a path are made.
+enum PathGenerator
+{
+	// A spline through anchor points 30, 60 and 90 m ahead, walked at the
+	// current speed.
+	PATH_SPLINE,
+	// Jerk minimising quintics in s and d towards the target lane and speed
+	// (see jmt.h), continued from the end of the previous path.
+	PATH_JMT
+};
+
+// How the speed changes from cycle to cycle.
+enum SpeedControl
+{
+	// 0.224 mph (0.1 m/s) up or down per telemetry message, so the
+	// acceleration depends on how often messages arrive.
+	SPEED_STEPS,
+	// A jerk limited profile (see velocity_profile.h) towards the target
+	// speed, slowing down for the car ahead, sampled for every new point.
+	SPEED_PROFILE
+};
+
+// How plan() decides and builds the path; the defaults are the original
+// rule based planner.
+struct PlannerOptions
+{
+	// When set, lane and speed come from scoring candidate manoeuvres (see
+	// behavior_planner.h) instead of from the lane change rules. Not owned.
+	const BehaviorPlanner *behavior = nullptr;
+	PathGenerator generator = PATH_SPLINE;
+	SpeedControl speed = SPEED_STEPS;
+	SpeedLimits speed_limits;
+	// Runs the lane change rules on their DYNAMIC_LANES instantiation even
+	// where one is specialised for the map's lane count, to check that both
+	// choose the same lanes.
+	bool dynamic_lanes = false;
+};
+
+// Runs one planning cycle and replaces 'trajectory' with the new path. Time
+// only ever comes from telemetry.received, so replaying recorded telemetry
+// with its original timestamps reproduces the original decisions. Does not
+// allocate once 'trajectory' has its capacity.
+void plan(const Telemetry &telemetry, PlannerState &state, const MapWaypoints &map, Trajectory &trajectory,
+	const PlannerOptions &options = PlannerOptions());
+
+#endif // PLANNER_H
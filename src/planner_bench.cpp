@@ -0,0 +1,827 @@
+// Microbenchmarks of the map conversions and spline kernels the planner runs
+// every cycle, on both shipped maps.
+//
+// Usage: planner_bench [--data DIR] [--samples N] [--filter TEXT] [--json FILE] [--baseline FILE]
+//        planner_bench --check
+//
+// Every benchmark runs on two query sets: "random" (points anywhere on the
+// road, in random order) and "trajectory" (consecutive positions of a car
+// driving down the road, the way the planner sees them). Each sample times a
+// batch of calls sized to take about 10 ms; the report gives the mean ns per
+// call with its 95% confidence interval, the median and the fastest sample.
+// --json writes the results, --baseline compares with such a file and marks
+// the benchmarks whose confidence intervals no longer overlap. The spline
+// benchmarks cover both tk::spline and the fixed-size CubicSpline the planner
+// uses.
+//
+// --check instead compares the indexes the planner answers its traffic
+// questions from with a plain scan of every car, on random traffic, and
+// fails on any disagreement.
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "cubic_spline.h"
+#include "json.hpp"
+#include "lane_occupancy.h"
+#include "occupancy_grid.h"
+#include "planner.h"
+#include "swept_collision.h"
+// The bench only uses the spline's default boundary conditions, which leaves
+// the file-local set_boundary() unused.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "spline.h"
+#pragma GCC diagnostic pop
+
+using namespace std;
+
+// for convenience
+using json = nlohmann::json;
+
+static const int QUERY_COUNT = 4096;
+static const int SPLINE_COUNT = 256;
+static const double SAMPLE_TARGET_NS = 10e6;
+
+// Keeps the compiler from dropping the benchmarked calls.
+static volatile double sink;
+
+// One position of the car, in both coordinate systems.
+struct Query
+{
+	double x;
+	double y;
+	double theta;
+	double s;
+	double d;
+};
+
+// Spline anchor points as the planner builds them: the car and a point
+// behind it, then 30, 60 and 90 m ahead in the target lane, in car
+// coordinates.
+struct SplineAnchors
+{
+	vector<double> x;
+	vector<double> y;
+};
+
+struct BenchResult
+{
+	string name;
+	string map;
+	string pattern;
+	size_t samples;
+	uint64_t calls_per_sample;
+	double mean;
+	double ci95;
+	double median;
+	double min;
+	double stddev;
+};
+
+// Two-sided 95% quantile of Student's t for 'df' degrees of freedom.
+static double tQuantile95(size_t df)
+{
+	static const double table[] = {
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+	if (df == 0)
+	{
+		return INFINITY;
+	}
+	return df <= 30 ? table[df - 1] : 1.96;
+}
+
+static double roadHeading(const MapWaypoints &map, double s, double d)
+{
+	vector<double> a = getXY(s, d, map.s, map.x, map.y);
+	vector<double> b = getXY(s + 1, d, map.s, map.x, map.y);
+	return atan2(b[1] - a[1], b[0] - a[0]);
+}
+
+static vector<Query> makeQueries(const MapWaypoints &map, bool random_order, mt19937 &rng)
+{
+	// Stay clear of the end so that 90 m spline anchors exist on open tracks.
+	double first_s = map.s.front() + 5;
+	double last_s = map.s.back() - 100;
+	uniform_real_distribution<double> s_dist(first_s, last_s);
+	uniform_real_distribution<double> d_dist(0.5, 11.5);
+	normal_distribution<double> heading_noise(0, 0.05);
+
+	vector<Query> queries;
+	double s = first_s;
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		Query q;
+		if (random_order)
+		{
+			q.s = s_dist(rng);
+			q.d = d_dist(rng);
+		}
+		else
+		{
+			// 50 mph in 0.02 s steps, weaving slowly across the lanes.
+			q.s = s;
+			q.d = 6 + 4 * sin(i / 300.0);
+			s += 0.447;
+			if (s >= last_s)
+			{
+				s = first_s;
+			}
+		}
+		vector<double> xy = getXY(q.s, q.d, map.s, map.x, map.y);
+		q.x = xy[0];
+		q.y = xy[1];
+		q.theta = roadHeading(map, q.s, q.d) + (random_order ? heading_noise(rng) : 0);
+		queries.push_back(q);
+	}
+	return queries;
+}
+
+static vector<SplineAnchors> makeAnchors(const MapWaypoints &map, const vector<Query> &queries)
+{
+	vector<SplineAnchors> anchors;
+	for (size_t i = 0; i < queries.size() && anchors.size() < SPLINE_COUNT; i++)
+	{
+		const Query &q = queries[i];
+		double target_d = 2 + 4 * min(2, max(0, (int)(q.d / 4)));
+		vector<double> pts_x = {q.x - cos(q.theta), q.x};
+		vector<double> pts_y = {q.y - sin(q.theta), q.y};
+		for (int ahead = 30; ahead <= 90; ahead += 30)
+		{
+			vector<double> xy = getXY(q.s + ahead, target_d, map.s, map.x, map.y);
+			pts_x.push_back(xy[0]);
+			pts_y.push_back(xy[1]);
+		}
+		SplineAnchors a;
+		for (size_t j = 0; j < pts_x.size(); j++)
+		{
+			double shift_x = pts_x[j] - q.x;
+			double shift_y = pts_y[j] - q.y;
+			a.x.push_back(shift_x * cos(-q.theta) - shift_y * sin(-q.theta));
+			a.y.push_back(shift_x * sin(-q.theta) + shift_y * cos(-q.theta));
+		}
+		// tk::spline needs strictly increasing x; sharp bends can break that.
+		bool increasing = true;
+		for (size_t j = 1; j < a.x.size(); j++)
+		{
+			increasing = increasing && a.x[j] > a.x[j - 1];
+		}
+		if (increasing)
+		{
+			anchors.push_back(a);
+		}
+	}
+	return anchors;
+}
+
+// Times 'call(i)' for i = 0, 1, 2, ... in batches of about SAMPLE_TARGET_NS.
+template <typename Call>
+static BenchResult runBenchmark(const string &name, const string &map, const string &pattern, size_t samples, Call call)
+{
+	// Warm up, then size the batches from the warm-up speed.
+	uint64_t calls = 1024;
+	double elapsed_ns = 0;
+	while (elapsed_ns < SAMPLE_TARGET_NS / 10)
+	{
+		auto start = chrono::steady_clock::now();
+		double total = 0;
+		for (uint64_t i = 0; i < calls; i++)
+		{
+			total += call(i);
+		}
+		sink = total;
+		elapsed_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+		if (elapsed_ns < SAMPLE_TARGET_NS / 10)
+		{
+			calls *= 2;
+		}
+	}
+	calls = max<uint64_t>(1, (uint64_t)(calls * SAMPLE_TARGET_NS / elapsed_ns));
+
+	vector<double> ns_per_call;
+	for (size_t s = 0; s < samples; s++)
+	{
+		auto start = chrono::steady_clock::now();
+		double total = 0;
+		for (uint64_t i = 0; i < calls; i++)
+		{
+			total += call(i);
+		}
+		sink = total;
+		ns_per_call.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / calls);
+	}
+
+	BenchResult r;
+	r.name = name;
+	r.map = map;
+	r.pattern = pattern;
+	r.samples = samples;
+	r.calls_per_sample = calls;
+	double sum = 0;
+	for (double v : ns_per_call)
+	{
+		sum += v;
+	}
+	r.mean = sum / samples;
+	double squares = 0;
+	for (double v : ns_per_call)
+	{
+		squares += (v - r.mean) * (v - r.mean);
+	}
+	r.stddev = samples > 1 ? sqrt(squares / (samples - 1)) : 0;
+	r.ci95 = tQuantile95(samples - 1) * r.stddev / sqrt((double)samples);
+	sort(ns_per_call.begin(), ns_per_call.end());
+	r.median = samples % 2 ? ns_per_call[samples / 2] : (ns_per_call[samples / 2 - 1] + ns_per_call[samples / 2]) / 2;
+	r.min = ns_per_call.front();
+	return r;
+}
+
+static string mapName(const string &file)
+{
+	size_t slash = file.find_last_of('/');
+	string name = slash == string::npos ? file : file.substr(slash + 1);
+	size_t dot = name.rfind('.');
+	return dot == string::npos ? name : name.substr(0, dot);
+}
+
+// Random traffic for the checks: up to 'max_cars' cars within 'range' m
+// ahead of s = 1000 on a road of 'lanes', some of them exactly on a lane
+// marking.
+static void randomTraffic(const LaneModel &lanes, int max_cars, double range, mt19937 &rng, VehicleTable &vehicles)
+{
+	uniform_real_distribution<double> s(1000, 1000 + range);
+	uniform_real_distribution<double> d(-1, lanes.count * lanes.width + 1);
+	uniform_real_distribution<double> speed(0, 25);
+	vehicles.clear();
+	int n = rng() % (max_cars + 1);
+	for (int i = 0; i < n; i++)
+	{
+		double car_d = rng() % 5 == 0 ? lanes.width * (rng() % (lanes.count + 1)) : d(rng);
+		vehicles.add(i, 0, 0, speed(rng), speed(rng), s(rng), car_d);
+	}
+	vehicles.predict((rng() % 50) * 0.02);
+}
+
+// LaneOccupancy's binary searches against the scan of every car the lane
+// change rules used to make: the gaps to the nearest cars clear of 'ahead'
+// and 'behind', or 0 for both if a car is in between. Returns the number of
+// lanes they disagree on.
+template <int LANES>
+static int checkLaneOccupancy(const LaneModel &lanes, int frames, mt19937 &rng)
+{
+	const double ahead = 40;
+	const double behind = 5;
+	const double none = 9999;
+	LaneOccupancy<LANES> occupancy;
+	VehicleTable vehicles;
+	uniform_real_distribution<double> car_s(1000, 1400);
+	int mismatches = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		randomTraffic(lanes, 300, 400, rng, vehicles);
+		occupancy.build(vehicles, lanes);
+		const double s = car_s(rng);
+		for (size_t i = 0; i < vehicles.size(); i++)
+		{
+			mismatches += occupancy.laneOf(i) != lanes.laneOf(vehicles.d[i]);
+		}
+		for (int lane = 0; lane < lanes.count; lane++)
+		{
+			double front = none;
+			double back = none;
+			for (size_t i = 0; i < vehicles.size(); i++)
+			{
+				if (lanes.laneOf(vehicles.d[i]) != lane)
+				{
+					continue;
+				}
+				double p = vehicles.predicted_s[i];
+				if (p > s && p - s > ahead)
+				{
+					front = min(front, p - s);
+				}
+				else if (p < s && s - p > behind)
+				{
+					back = min(back, s - p);
+				}
+				else
+				{
+					front = 0;
+					back = 0;
+				}
+			}
+
+			double indexed_front = none;
+			double indexed_back = none;
+			double gap;
+			if (occupancy.occupied(lane, s, behind, ahead))
+			{
+				indexed_front = 0;
+				indexed_back = 0;
+			}
+			else
+			{
+				if (occupancy.leader(lane, s, ahead, gap) >= 0)
+				{
+					indexed_front = gap;
+				}
+				if (occupancy.follower(lane, s, behind, gap) >= 0)
+				{
+					indexed_back = gap;
+				}
+			}
+			mismatches += front != indexed_front || back != indexed_back;
+		}
+	}
+	return mismatches;
+}
+
+// Random predictions for the cars of 'vehicles': 'steps' steps of 'dt' at
+// their own speed, drifting across the road at up to 1.5 m/s.
+static void randomPrediction(const VehicleTable &vehicles, const LaneModel &lanes, int steps, double dt, mt19937 &rng,
+	PredictionBuffer &prediction)
+{
+	uniform_real_distribution<double> drift(-1.5, 1.5);
+	const int n = vehicles.size();
+	prediction.resize(n, steps, dt);
+	for (int i = 0; i < n; i++)
+	{
+		double lateral = drift(rng);
+		for (int k = 0; k < steps; k++)
+		{
+			double t = (k + 1) * dt;
+			prediction.s_at[k * n + i] = vehicles.s[i] + vehicles.speed[i] * t;
+			prediction.d_at[k * n + i] = min(lanes.count * lanes.width, max(0.0, vehicles.d[i] + lateral * t));
+		}
+	}
+}
+
+// OccupancyGrid against the cars it was built from. 'mismatches' counts
+// queries where the grid disagrees with the footprints of every car laid
+// on the same 1 m bins and lanes; 'misses' counts footprints that overlap
+// a car exactly (both inside the grid) but that the grid reports as free.
+static void checkOccupancyGrid(const LaneModel &lanes, int frames, mt19937 &rng, int &mismatches, int &misses)
+{
+	const double length = 5;
+	const double width = 2;
+	const int steps = 20;
+	const int queries = 200;
+	OccupancyGrid grid(length, width);
+	VehicleTable vehicles;
+	PredictionBuffer prediction;
+	uniform_real_distribution<double> unit(0, 1);
+	mismatches = 0;
+	misses = 0;
+
+	// First and last bin, and first and last lane, of a footprint at 's',
+	// 'd'; false if it is off the grid.
+	double origin = 0;
+	auto cells = [&](double s, double d, int &first_bin, int &last_bin, int &first_lane, int &last_lane) {
+		double from = s - length / 2 - origin;
+		double to = s + length / 2 - origin;
+		if (to < 0 || from >= OccupancyGrid::BINS)
+		{
+			return false;
+		}
+		first_bin = max(0, (int)floor(from));
+		last_bin = min(OccupancyGrid::BINS - 1, (int)floor(to));
+		first_lane = max(0, (int)floor((d - width / 2) / lanes.width));
+		last_lane = min(lanes.count - 1, (int)floor((d + width / 2) / lanes.width));
+		return first_lane <= last_lane;
+	};
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		randomTraffic(lanes, 30, 300, rng, vehicles);
+		randomPrediction(vehicles, lanes, steps, 0.2, rng, prediction);
+		const double car_s = 1000 + unit(rng) * 100;
+		const int car_lane = rng() % lanes.count;
+		grid.build(vehicles, prediction, lanes, car_s, car_lane);
+		origin = floor(car_s) - OccupancyGrid::BEHIND;
+
+		for (int q = 0; q < queries; q++)
+		{
+			const int k = rng() % steps;
+			// Footprints well inside the grid and the road.
+			const double s = origin + length + unit(rng) * (OccupancyGrid::BINS - 2 * length);
+			const double d = width / 2 + unit(rng) * (lanes.count * lanes.width - width);
+			int first_bin = 0;
+			int last_bin = 0;
+			int first_lane = 0;
+			int last_lane = 0;
+			cells(s, d, first_bin, last_bin, first_lane, last_lane);
+			bool binned = false;
+			bool overlaps = false;
+			for (int i = 0; i < prediction.count; i++)
+			{
+				if (vehicles.predicted_s[i] < car_s && lanes.laneOf(vehicles.d[i]) == car_lane)
+				{
+					continue;
+				}
+				const double other_s = prediction.s(k, i);
+				const double other_d = prediction.d(k, i);
+				int other_first_bin;
+				int other_last_bin;
+				int other_first_lane;
+				int other_last_lane;
+				if (cells(other_s, other_d, other_first_bin, other_last_bin, other_first_lane, other_last_lane) &&
+					other_first_bin <= last_bin && first_bin <= other_last_bin && other_first_lane <= last_lane &&
+					first_lane <= other_last_lane)
+				{
+					binned = true;
+				}
+				overlaps = overlaps || (fabs(other_s - s) < length && fabs(other_d - d) < width);
+			}
+			const bool hit = grid.collides(k, s, d);
+			mismatches += hit != binned;
+			misses += overlaps && !hit;
+		}
+	}
+}
+
+// Whether boxes of half length 'hl' and half width 'hw' centred at 'a' and
+// 'b', heading along unit vectors 'ua' and 'ub', overlap: the separating
+// axis test on their four edge normals.
+static bool boxesOverlap(const double a[2], const double ua[2], const double b[2], const double ub[2], double hl, double hw)
+{
+	const double axes[4][2] = {{ua[0], ua[1]}, {-ua[1], ua[0]}, {ub[0], ub[1]}, {-ub[1], ub[0]}};
+	for (const auto &axis : axes)
+	{
+		double ra = hl * fabs(ua[0] * axis[0] + ua[1] * axis[1]) + hw * fabs(-ua[1] * axis[0] + ua[0] * axis[1]);
+		double rb = hl * fabs(ub[0] * axis[0] + ub[1] * axis[1]) + hw * fabs(-ub[1] * axis[0] + ub[0] * axis[1]);
+		if (fabs((b[0] - a[0]) * axis[0] + (b[1] - a[1]) * axis[1]) > ra + rb)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Unit heading of a motion by 'ds', 'dd'; along the road if there is hardly
+// any motion, like SweptCollisionChecker does.
+static void motionHeading(double ds, double dd, double u[2])
+{
+	double length = sqrt(ds * ds + dd * dd);
+	u[0] = length < 1e-3 ? 1 : ds / length;
+	u[1] = length < 1e-3 ? 0 : dd / length;
+}
+
+// SweptCollisionChecker against the plain test it stands for: both cars
+// moved in 16 sub-steps over every step, their boxes overlapped in double
+// precision at each. 'misses' counts trajectories where the sub-steps touch
+// a car before the checker says; 'earlier' those where the checker, whose
+// swept boxes cover the whole motion of a step, reports a step before any
+// sub-step touches, which it may.
+static void checkSweptCollisions(const LaneModel &lanes, int frames, mt19937 &rng, int &misses, int &earlier)
+{
+	const double half_length = 2.5;
+	const double half_width = 1;
+	const int steps = 20;
+	const double dt = 0.2;
+	const int trajectories = 20;
+	const int sub_steps = 16;
+	SweptCollisionChecker checker(2 * half_length, 2 * half_width);
+	VehicleTable vehicles;
+	PredictionBuffer prediction;
+	uniform_real_distribution<double> unit(0, 1);
+	misses = 0;
+	earlier = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		randomTraffic(lanes, 30, 120, rng, vehicles);
+		randomPrediction(vehicles, lanes, steps, dt, rng, prediction);
+		const int n = prediction.count;
+		const double s0 = 1000 + unit(rng) * 40;
+		const int lane = rng() % lanes.count;
+		checker.build(vehicles, prediction, lanes, s0, lane);
+
+		for (int t = 0; t < trajectories; t++)
+		{
+			// Keep the lane or change to any other over 2.5 s.
+			double s[steps];
+			double d[steps];
+			const double speed = unit(rng) * 25;
+			const double d0 = lanes.center(lane);
+			const double d1 = lanes.center(rng() % lanes.count);
+			for (int k = 0; k < steps; k++)
+			{
+				double time = (k + 1) * dt;
+				s[k] = s0 + speed * time;
+				d[k] = d0 + (d1 - d0) * min(1.0, time / 2.5);
+			}
+			const int found = checker.firstCollision(s, d, steps, s0, d0);
+
+			int touched = -1;
+			for (int k = 0; k < steps && touched < 0; k++)
+			{
+				const double from[2] = {k > 0 ? s[k - 1] : s0, k > 0 ? d[k - 1] : d0};
+				double u[2];
+				motionHeading(s[k] - from[0], d[k] - from[1], u);
+				for (int i = 0; i < n && touched < 0; i++)
+				{
+					if (vehicles.predicted_s[i] < s0 && lanes.laneOf(vehicles.d[i]) == lane)
+					{
+						continue;
+					}
+					const double to_other[2] = {prediction.s(k, i), prediction.d(k, i)};
+					const double from_other[2] = {
+						k > 0 ? prediction.s(k - 1, i) : 2 * prediction.s(0, i) - prediction.s(1, i),
+						k > 0 ? prediction.d(k - 1, i) : 2 * prediction.d(0, i) - prediction.d(1, i)};
+					double u_other[2];
+					motionHeading(to_other[0] - from_other[0], to_other[1] - from_other[1], u_other);
+					for (int j = 0; j <= sub_steps; j++)
+					{
+						double f = (double)j / sub_steps;
+						const double a[2] = {from[0] + (s[k] - from[0]) * f, from[1] + (d[k] - from[1]) * f};
+						const double b[2] = {from_other[0] + (to_other[0] - from_other[0]) * f,
+							from_other[1] + (to_other[1] - from_other[1]) * f};
+						if (boxesOverlap(a, u, b, u_other, half_length, half_width))
+						{
+							touched = k;
+							break;
+						}
+					}
+				}
+			}
+			misses += touched >= 0 && (found < 0 || found > touched);
+			earlier += found >= 0 && (touched < 0 || found < touched);
+		}
+	}
+}
+
+// Runs every check and prints one line each; returns false if any of them
+// found a mismatch.
+static bool runChecks()
+{
+	const int frames = 5000;
+	mt19937 rng(1);
+	bool ok = true;
+	auto report = [&ok](const string &name, int frames, int mismatches) {
+		cout << left << setw(40) << name << right << setw(8) << frames << " frames" << setw(8) << mismatches
+			<< " mismatches" << endl;
+		ok = ok && mismatches == 0;
+	};
+
+	for (int count = 2; count <= 5; count++)
+	{
+		LaneModel lanes;
+		lanes.count = count;
+		string name = "LaneOccupancy<" + (count <= 4 ? to_string(count) : string("DYNAMIC_LANES")) + "> " +
+			to_string(count) + " lanes";
+		int mismatches = 0;
+		switch (count)
+		{
+		case 2:
+			mismatches = checkLaneOccupancy<2>(lanes, frames, rng);
+			break;
+		case 3:
+			mismatches = checkLaneOccupancy<3>(lanes, frames, rng);
+			break;
+		case 4:
+			mismatches = checkLaneOccupancy<4>(lanes, frames, rng);
+			break;
+		default:
+			mismatches = checkLaneOccupancy<DYNAMIC_LANES>(lanes, frames, rng);
+			break;
+		}
+		report(name, frames, mismatches);
+	}
+
+	for (int count = 3; count <= 4; count++)
+	{
+		LaneModel lanes;
+		lanes.count = count;
+		int mismatches = 0;
+		int misses = 0;
+		checkOccupancyGrid(lanes, frames, rng, mismatches, misses);
+		report("OccupancyGrid " + to_string(count) + " lanes, binned cars", frames, mismatches);
+		report("OccupancyGrid " + to_string(count) + " lanes, overlaps missed", frames, misses);
+	}
+
+	for (int count = 3; count <= 4; count++)
+	{
+		LaneModel lanes;
+		lanes.count = count;
+		int misses = 0;
+		int earlier = 0;
+		checkSweptCollisions(lanes, frames, rng, misses, earlier);
+		report("SweptCollisionChecker " + to_string(count) + " lanes, missed", frames, misses);
+		// Not a mismatch: the bound of a swept box.
+		cout << left << setw(40) << "SweptCollisionChecker " + to_string(count) + " lanes, earlier" << right
+			<< setw(8) << frames << " frames" << setw(8) << earlier << " trajectories" << endl;
+	}
+	return ok;
+}
+
+static json toJson(const BenchResult &r)
+{
+	return json{{"name", r.name}, {"map", r.map}, {"pattern", r.pattern}, {"samples", r.samples},
+		{"calls_per_sample", r.calls_per_sample}, {"ns_per_op", r.mean}, {"ci95", r.ci95},
+		{"median", r.median}, {"min", r.min}, {"stddev", r.stddev}};
+}
+
+int main(int argc, char *argv[])
+{
+	string data_dir = "../data";
+	size_t samples = 20;
+	string filter;
+	string json_file;
+	string baseline_file;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--check") == 0)
+		{
+			return runChecks() ? 0 : 1;
+		}
+		else if (strcmp(argv[i], "--data") == 0 && i + 1 < argc)
+		{
+			data_dir = argv[++i];
+		}
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+		{
+			samples = max(2, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+		{
+			filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+		{
+			json_file = argv[++i];
+		}
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+		{
+			baseline_file = argv[++i];
+		}
+		else
+		{
+			cerr << "Usage: " << argv[0] << " [--data DIR] [--samples N] [--filter TEXT] [--json FILE] [--baseline FILE]"
+				<< " | --check" << endl;
+			return -1;
+		}
+	}
+
+	std::map<string, json> baseline;
+	if (!baseline_file.empty())
+	{
+		ifstream in(baseline_file);
+		if (!in)
+		{
+			cerr << "Failed to open baseline " << baseline_file << endl;
+			return -1;
+		}
+		json b;
+		in >> b;
+		for (const auto &r : b["benchmarks"])
+		{
+			baseline[r["name"].get<string>() + "/" + r["map"].get<string>() + "/" + r["pattern"].get<string>()] = r;
+		}
+	}
+
+	vector<BenchResult> results;
+	cout << fixed << setprecision(1);
+	cout << left << setw(24) << "benchmark" << setw(20) << "map" << setw(12) << "pattern" << right
+		<< setw(12) << "ns/op" << setw(10) << "+-95%" << setw(10) << "median" << setw(10) << "min";
+	if (!baseline.empty())
+	{
+		cout << setw(12) << "vs base";
+	}
+	cout << endl;
+
+	for (const char *file : {"highway_map.csv", "highway_map_bosch1.csv"})
+	{
+		MapWaypoints map;
+		string path = data_dir + "/" + file;
+		if (!loadMap(path, map))
+		{
+			cerr << "Failed to load map " << path << endl;
+			return -1;
+		}
+		string map_name = mapName(file);
+
+		for (bool random_order : {true, false})
+		{
+			string pattern = random_order ? "random" : "trajectory";
+			mt19937 rng(42);
+			vector<Query> queries = makeQueries(map, random_order, rng);
+			vector<SplineAnchors> anchors = makeAnchors(map, queries);
+			vector<tk::spline> splines(anchors.size());
+			for (size_t i = 0; i < anchors.size(); i++)
+			{
+				splines[i].set_points(anchors[i].x, anchors[i].y);
+			}
+			tk::spline reused;
+			vector<CubicSpline> cubic_splines(anchors.size());
+			for (size_t i = 0; i < anchors.size(); i++)
+			{
+				cubic_splines[i].set_points(anchors[i].x.data(), anchors[i].y.data(), anchors[i].x.size());
+			}
+			CubicSpline cubic_reused;
+
+			auto q = [&queries](uint64_t i) -> const Query & { return queries[i % queries.size()]; };
+			auto report = [&](const BenchResult &r) {
+				cout << left << setw(24) << r.name << setw(20) << r.map << setw(12) << r.pattern << right
+					<< setw(12) << r.mean << setw(10) << r.ci95 << setw(10) << r.median << setw(10) << r.min;
+				auto base = baseline.find(r.name + "/" + r.map + "/" + r.pattern);
+				if (base != baseline.end())
+				{
+					double base_mean = base->second["ns_per_op"];
+					double base_ci = base->second["ci95"];
+					bool significant = fabs(r.mean - base_mean) > r.ci95 + base_ci;
+					cout << setw(10) << showpos << (r.mean / base_mean - 1) * 100 << noshowpos << "%"
+						<< (significant ? (r.mean < base_mean ? " faster" : " slower") : "");
+				}
+				cout << endl;
+				results.push_back(r);
+			};
+			auto wanted = [&filter](const char *name) { return filter.empty() || strstr(name, filter.c_str()); };
+
+			if (wanted("ClosestWaypoint"))
+			{
+				report(runBenchmark("ClosestWaypoint", map_name, pattern, samples, [&](uint64_t i) {
+					return (double)ClosestWaypoint(q(i).x, q(i).y, map.x, map.y);
+				}));
+			}
+			if (wanted("NextWaypoint"))
+			{
+				report(runBenchmark("NextWaypoint", map_name, pattern, samples, [&](uint64_t i) {
+					return (double)NextWaypoint(q(i).x, q(i).y, q(i).theta, map.x, map.y);
+				}));
+			}
+			if (wanted("getFrenet"))
+			{
+				report(runBenchmark("getFrenet", map_name, pattern, samples, [&](uint64_t i) {
+					return getFrenet(q(i).x, q(i).y, q(i).theta, map.x, map.y)[0];
+				}));
+			}
+			if (wanted("getXY"))
+			{
+				report(runBenchmark("getXY", map_name, pattern, samples, [&](uint64_t i) {
+					return getXY(q(i).s, q(i).d, map.s, map.x, map.y)[0];
+				}));
+			}
+			if (wanted("spline_set_points"))
+			{
+				report(runBenchmark("spline_set_points", map_name, pattern, samples, [&](uint64_t i) {
+					const SplineAnchors &a = anchors[i % anchors.size()];
+					reused.set_points(a.x, a.y);
+					return reused(15.0);
+				}));
+			}
+			if (wanted("spline_eval"))
+			{
+				// The planner samples up to 50 points within the first 30 m.
+				report(runBenchmark("spline_eval", map_name, pattern, samples, [&](uint64_t i) {
+					return splines[(i / 50) % splines.size()](0.6 * (i % 50));
+				}));
+			}
+			if (wanted("cubic_spline_set_points"))
+			{
+				report(runBenchmark("cubic_spline_set_points", map_name, pattern, samples, [&](uint64_t i) {
+					const SplineAnchors &a = anchors[i % anchors.size()];
+					cubic_reused.set_points(a.x.data(), a.y.data(), a.x.size());
+					return cubic_reused(15.0);
+				}));
+			}
+			if (wanted("cubic_spline_eval"))
+			{
+				report(runBenchmark("cubic_spline_eval", map_name, pattern, samples, [&](uint64_t i) {
+					return cubic_splines[(i / 50) % cubic_splines.size()](0.6 * (i % 50));
+				}));
+			}
+		}
+	}
+
+	if (!json_file.empty())
+	{
+		json out;
+		time_t now = time(nullptr);
+		char date[32];
+		strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+		out["context"] = {{"date", date}, {"compiler", __VERSION__}, {"samples", samples}};
+		out["benchmarks"] = json::array();
+		for (const auto &r : results)
+		{
+			out["benchmarks"].push_back(toJson(r));
+		}
+		ofstream f(json_file);
+		f << setw(2) << out << endl;
+		if (!f)
+		{
+			cerr << "Failed to write " << json_file << endl;
+			return -1;
+		}
+	}
+	return 0;
+}
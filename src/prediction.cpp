@@ -0,0 +1,267 @@
+#include "prediction.h"
+#include <math.h>
+#include <algorithm>
+// Eigen 3.3 predates GCC's -Wint-in-bool-context and trips it.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-in-bool-context"
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/LU"
+#pragma GCC diagnostic pop
+
+using namespace std;
+
+namespace
+{
+	// Ids above this are not tracked (index_of_ is sized by id); the
+	// simulator numbers its cars from 0.
+	const int MAX_TRACKED_ID = 1 << 16;
+	// A report this far from where the track would have put the car (m)
+	// starts a new track: the car was respawned or wrapped round the track.
+	const double MAX_JUMP = 20;
+	// Kalman filter noise: the spectral densities of the jerk along the
+	// road ((m/s^3)^2 s) and of the lateral acceleration ((m/s^2)^2 s), and
+	// the standard deviations of the reported s (m), speed (m/s) and d (m).
+	const double JERK_NOISE = 16;
+	const double LATERAL_NOISE = 1;
+	const double S_DEVIATION = 0.5;
+	const double SPEED_DEVIATION = 0.3;
+	const double D_DEVIATION = 0.1;
+	// Deviations a new track starts with: acceleration (m/s^2) and lateral
+	// speed (m/s).
+	const double INITIAL_ACCELERATION_DEVIATION = 2;
+	const double INITIAL_LATERAL_DEVIATION = 1;
+	// Bounds of the estimated acceleration (m/s^2), and how long a car is
+	// predicted to keep it (s).
+	const double MAX_ACCELERATION = 5;
+	const double ACCELERATION_TIME = 2;
+	// Lateral speed from which a car counts as changing lanes (m/s), and
+	// how far ahead its target lane is looked for (s).
+	const double LANE_CHANGE_SPEED = 0.5;
+	const double LANE_CHANGE_LOOKAHEAD = 2;
+}
+
+VehicleTracker::VehicleTracker() : frame_(0)
+{
+	tracks_.reserve(32);
+	filters_.reserve(32);
+	index_of_.reserve(32);
+	estimates_.reserve(32);
+}
+
+int VehicleTracker::find(int id) const
+{
+	if (id < 0 || id >= (int)index_of_.size())
+	{
+		return -1;
+	}
+	return index_of_[id];
+}
+
+void VehicleTracker::drop(int index)
+{
+	index_of_[tracks_[index].id] = -1;
+	if (index != (int)tracks_.size() - 1)
+	{
+		tracks_[index] = tracks_.back();
+		filters_[index] = filters_.back();
+		index_of_[tracks_[index].id] = index;
+	}
+	tracks_.pop_back();
+	filters_.pop_back();
+}
+
+void VehicleTracker::update(const VehicleTable &vehicles, chrono::steady_clock::time_point time, const LaneModel &lanes)
+{
+	frame_++;
+	const int n = vehicles.size();
+	for (int row = 0; row < n; row++)
+	{
+		const int id = vehicles.id[row];
+		if (id < 0 || id >= MAX_TRACKED_ID)
+		{
+			continue;
+		}
+		int index = find(id);
+		double dt = -1;
+		if (index >= 0)
+		{
+			const Track &track = tracks_[index];
+			int last = (track.next + HISTORY - 1) % HISTORY;
+			dt = chrono::duration<double>(time - track.time[last]).count();
+			double expected = track.s[last] + track.speed[last] * dt;
+			if (track.seen == frame_ || dt <= 0 || fabs(vehicles.s[row] - expected) > MAX_JUMP)
+			{
+				// A duplicate id, time going backwards or a jump: start over.
+				drop(index);
+				index = -1;
+				dt = -1;
+			}
+		}
+		if (index < 0)
+		{
+			if (id >= (int)index_of_.size())
+			{
+				index_of_.resize(id + 1, -1);
+			}
+			index = tracks_.size();
+			index_of_[id] = index;
+			tracks_.push_back(Track());
+			filters_.push_back(FrenetFilter());
+			Track &track = tracks_.back();
+			track.id = id;
+			track.count = 0;
+			track.next = 0;
+		}
+
+		Track &track = tracks_[index];
+		track.seen = frame_;
+		track.time[track.next] = time;
+		track.s[track.next] = vehicles.s[row];
+		track.d[track.next] = vehicles.d[row];
+		track.speed[track.next] = vehicles.speed[row];
+		track.next = (track.next + 1) % HISTORY;
+		track.count = min(track.count + 1, (int)HISTORY);
+
+		FrenetFilter &filter = filters_[index];
+		filter.dt = dt;
+		filter.measured_s = vehicles.s[row];
+		filter.measured_speed = vehicles.speed[row];
+		filter.measured_d = vehicles.d[row];
+	}
+
+	// Expire the cars that were not reported, one swap each.
+	for (int index = 0; index < (int)tracks_.size();)
+	{
+		if (tracks_[index].seen != frame_)
+		{
+			drop(index);
+		}
+		else
+		{
+			index++;
+		}
+	}
+
+	filter();
+
+	estimates_.resize(n);
+	for (int row = 0; row < n; row++)
+	{
+		TrackEstimate &estimate = estimates_[row];
+		estimate.speed = vehicles.speed[row];
+		estimate.acceleration = 0;
+		estimate.lateral_speed = 0;
+		estimate.lane = lanes.laneOf(vehicles.d[row]);
+		estimate.target_lane = estimate.lane;
+		int index = find(vehicles.id[row]);
+		if (index < 0)
+		{
+			continue;
+		}
+		const FrenetFilter &filter = filters_[index];
+		estimate.speed = max(0.0, filter.along[1]);
+		estimate.acceleration = max(-MAX_ACCELERATION, min(MAX_ACCELERATION, filter.along[2]));
+		estimate.lateral_speed = filter.across[1];
+		if (fabs(estimate.lateral_speed) >= LANE_CHANGE_SPEED)
+		{
+			int target = lanes.laneOf(vehicles.d[row] + estimate.lateral_speed * LANE_CHANGE_LOOKAHEAD);
+			if (target >= 0)
+			{
+				estimate.target_lane = target;
+			}
+		}
+	}
+}
+
+void VehicleTracker::filter()
+{
+	const Eigen::Matrix2d R = Eigen::Vector2d(S_DEVIATION * S_DEVIATION, SPEED_DEVIATION * SPEED_DEVIATION).asDiagonal();
+	const double r_d = D_DEVIATION * D_DEVIATION;
+
+	for (FrenetFilter &filter : filters_)
+	{
+		Eigen::Map<Eigen::Vector3d> x(filter.along);
+		Eigen::Map<Eigen::Matrix3d> P(filter.along_covariance);
+		Eigen::Map<Eigen::Vector2d> y(filter.across);
+		Eigen::Map<Eigen::Matrix2d> C(filter.across_covariance);
+		const double dt = filter.dt;
+		if (dt < 0)
+		{
+			x << filter.measured_s, filter.measured_speed, 0;
+			P = Eigen::Vector3d(S_DEVIATION * S_DEVIATION, SPEED_DEVIATION * SPEED_DEVIATION,
+				INITIAL_ACCELERATION_DEVIATION * INITIAL_ACCELERATION_DEVIATION).asDiagonal();
+			y << filter.measured_d, 0;
+			C = Eigen::Vector2d(r_d, INITIAL_LATERAL_DEVIATION * INITIAL_LATERAL_DEVIATION).asDiagonal();
+			continue;
+		}
+		const double dt2 = dt * dt;
+		const double dt3 = dt2 * dt;
+
+		// Along the road: constant acceleration, driven by white jerk.
+		Eigen::Matrix3d F;
+		F << 1, dt, dt2 / 2,
+			0, 1, dt,
+			0, 0, 1;
+		Eigen::Matrix3d process;
+		process << dt3 * dt2 / 20, dt2 * dt2 / 8, dt3 / 6,
+			dt2 * dt2 / 8, dt3 / 3, dt2 / 2,
+			dt3 / 6, dt2 / 2, dt;
+		x = F * x;
+		P = F * P * F.transpose() + JERK_NOISE * process;
+		// s and speed are measured directly, so H P H' and P H' are blocks of P.
+		Eigen::Vector2d innovation(filter.measured_s - x(0), filter.measured_speed - x(1));
+		Eigen::Matrix2d S = P.topLeftCorner<2, 2>() + R;
+		Eigen::Matrix<double, 3, 2> K = P.leftCols<2>() * S.inverse();
+		x += K * innovation;
+		P -= K * P.topRows<2>();
+
+		// Across it: constant velocity, driven by white acceleration.
+		Eigen::Matrix2d G;
+		G << 1, dt,
+			0, 1;
+		Eigen::Matrix2d lateral_process;
+		lateral_process << dt3 / 3, dt2 / 2,
+			dt2 / 2, dt;
+		y = G * y;
+		C = G * C * G.transpose() + LATERAL_NOISE * lateral_process;
+		Eigen::Vector2d k_d = C.col(0) / (C(0, 0) + r_d);
+		y += k_d * (filter.measured_d - y(0));
+		C -= k_d * C.row(0);
+	}
+}
+
+void VehicleTracker::predict(const VehicleTable &vehicles, double offset, int steps, double dt, const LaneModel &lanes,
+	PredictionBuffer &out) const
+{
+	const int n = vehicles.size();
+	out.resize(n, steps, dt);
+	for (int row = 0; row < n; row++)
+	{
+		const TrackEstimate &estimate = estimates_[row];
+		const double s0 = vehicles.s[row];
+		const double d0 = vehicles.d[row];
+		const double v0 = estimate.speed;
+		const double a = estimate.acceleration;
+		// Until the acceleration runs out (or the car stops), then at the
+		// speed reached.
+		double accelerating = ACCELERATION_TIME;
+		if (a < 0)
+		{
+			accelerating = min(accelerating, v0 / -a);
+		}
+		const double v1 = v0 + a * accelerating;
+		const double s1 = s0 + (v0 + v1) / 2 * accelerating;
+
+		const double d_to = estimate.target_lane != estimate.lane && estimate.target_lane >= 0
+			? lanes.center(estimate.target_lane) : d0;
+		const double lateral = fabs(estimate.lateral_speed);
+		for (int k = 0; k < steps; k++)
+		{
+			double t = offset + (k + 1) * dt;
+			double s = t < accelerating ? s0 + (v0 + a * t / 2) * t : s1 + v1 * (t - accelerating);
+			double d = d_to > d0 ? min(d_to, d0 + lateral * t) : max(d_to, d0 - lateral * t);
+			out.s_at[k * n + row] = s;
+			out.d_at[k * n + row] = d;
+		}
+	}
+}
@@ -0,0 +1,120 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "lane_occupancy.h"
+#include "vehicle_table.h"
+
+// What the history of one car says about its motion.
+struct TrackEstimate
+{
+	double speed;          // m/s, along the road
+	double acceleration;   // m/s^2, along the road
+	double lateral_speed;  // m/s, positive away from the yellow line
+	int lane;              // lane it is in, -1 on a lane marking
+	int target_lane;       // lane it is moving to; 'lane' if it is keeping it
+};
+
+// Where the cars of one frame are predicted to be at fixed times, in the row
+// order of their VehicleTable. Step-major, so that the cars at one step are
+// contiguous: s(k, i) is car i after (k + 1) * dt. Reusing an instance keeps
+// its capacity.
+struct PredictionBuffer
+{
+	int count = 0;  // cars
+	int steps = 0;
+	double dt = 0;  // s
+	std::vector<double> s_at;
+	std::vector<double> d_at;
+
+	double s(int step, int row) const { return s_at[step * count + row]; }
+	double d(int step, int row) const { return d_at[step * count + row]; }
+
+	void resize(int cars, int sample_steps, double step_time)
+	{
+		count = cars;
+		steps = sample_steps;
+		dt = step_time;
+		s_at.resize(cars * sample_steps);
+		d_at.resize(cars * sample_steps);
+	}
+};
+
+// The last few sensor fusion reports of every car of one session, keyed by
+// sensor fusion id. Each report goes into a small ring buffer per car and
+// into the car's Kalman filters in Frenet space: constant acceleration along
+// the road, measuring s and speed, and constant velocity across it,
+// measuring d. The filters give the car's speed, acceleration and lateral
+// speed, and the lateral speed whether it is changing lanes. Tracks and
+// their filters live in two dense arrays indexed through the id, so looking
+// one up is O(1) and a car that is no longer reported is dropped in O(1) by
+// moving the last one into its place; all filters are stepped in one pass
+// over their array per frame. Capacity is kept, so only frames with more
+// cars or higher ids than any before allocate.
+class VehicleTracker
+{
+public:
+	static const int HISTORY = 8;
+
+	VehicleTracker();
+
+	// Adds the cars of 'vehicles', reported at 'time', to their tracks,
+	// starts tracks for new ones and drops those that are missing. The
+	// estimates are then those of the rows of 'vehicles'.
+	void update(const VehicleTable &vehicles, std::chrono::steady_clock::time_point time, const LaneModel &lanes);
+
+	const TrackEstimate &estimate(int row) const { return estimates_[row]; }
+	size_t tracked() const { return tracks_.size(); }
+
+	// Fills 'out' with the positions of the cars of the last update after
+	// offset + (k + 1) * dt seconds, k < steps. Along the road a car keeps
+	// its estimated acceleration for a while and its speed after that, and never
+	// reverses; across it, a car changing lanes moves on at its lateral
+	// speed until it reaches the centre of its target lane.
+	void predict(const VehicleTable &vehicles, double offset, int steps, double dt, const LaneModel &lanes,
+		PredictionBuffer &out) const;
+
+private:
+	struct Track
+	{
+		int id;
+		int count;  // reports held, up to HISTORY
+		int next;   // ring buffer slot of the next report
+		uint64_t seen;
+		std::chrono::steady_clock::time_point time[HISTORY];
+		double s[HISTORY];
+		double d[HISTORY];
+		double speed[HISTORY];
+	};
+
+	// State and covariance (column-major) of the filters of one track, and
+	// the report they are to take in next.
+	struct FrenetFilter
+	{
+		double along[3];  // s, speed, acceleration
+		double along_covariance[9];
+		double across[2];  // d, lateral speed
+		double across_covariance[4];
+		double dt;  // since the previous report; negative for a new track
+		double measured_s;
+		double measured_speed;
+		double measured_d;
+	};
+
+	// Steps every filter to its report.
+	void filter();
+
+	// Index of the track of 'id' in tracks_, -1 if there is none.
+	int find(int id) const;
+	void drop(int index);
+
+	std::vector<Track> tracks_;
+	std::vector<FrenetFilter> filters_;  // by track
+	std::vector<int> index_of_;  // by id
+	std::vector<TrackEstimate> estimates_;  // by row of the last update
+	uint64_t frame_;
+};
+
+#endif // PREDICTION_H
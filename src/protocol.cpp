@@ -0,0 +1,154 @@
+#include "protocol.h"
+#include "stage_timer.h"
+#include <algorithm>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+using namespace std;
+
+// for convenience
+using json = nlohmann::json;
+
+// Checks if the SocketIO event has JSON data.
+// If there is data the JSON object in string format will be returned,
+// else the empty string "" will be returned.
+string hasData(string s) {
+  auto found_null = s.find("null");
+  auto b1 = s.find_first_of("[");
+  auto b2 = s.find_first_of("}");
+  if (found_null != string::npos) {
+    return "";
+  } else if (b1 != string::npos && b2 != string::npos) {
+    return s.substr(b1, b2 - b1 + 2);
+  }
+  return "";
+}
+
+bool findData(const char *data, size_t length, size_t &offset, size_t &size)
+{
+	const char *end = data + length;
+	static const char null_text[] = "null";
+	if (search(data, end, null_text, null_text + 4) != end)
+	{
+		return false;
+	}
+	const char *b1 = find(data, end, '[');
+	const char *b2 = find(data, end, '}');
+	if (b1 == end || b2 == end)
+	{
+		return false;
+	}
+	// hasData() keeps the character after the closing brace (the ']' of
+	// the event array), if there is one.
+	offset = b1 - data;
+	size = b2 >= b1 ? min<size_t>(b2 - b1 + 2, end - b1) : end - b1;
+	return true;
+}
+
+namespace
+{
+	void decodeTelemetry(const ArenaJson &telemetry, chrono::steady_clock::time_point received, Telemetry &out)
+	{
+		out.received = received;
+		out.x = telemetry["x"];
+		out.y = telemetry["y"];
+		out.s = telemetry["s"];
+		out.d = telemetry["d"];
+		out.yaw = telemetry["yaw"];
+		out.speed = telemetry["speed"];
+
+		out.previous_path_x.clear();
+		for (const auto &x : telemetry["previous_path_x"])
+		{
+			out.previous_path_x.push_back(x);
+		}
+		out.previous_path_y.clear();
+		for (const auto &y : telemetry["previous_path_y"])
+		{
+			out.previous_path_y.push_back(y);
+		}
+		out.end_path_s = telemetry["end_path_s"];
+		out.end_path_d = telemetry["end_path_d"];
+
+		out.vehicles.clear();
+		for (const auto &car : telemetry["sensor_fusion"])
+		{
+			out.vehicles.add(car[0], car[1], car[2], car[3], car[4], car[5], car[6]);
+		}
+		out.vehicles.predict((double)out.previous_path_x.size() * POINT_INTERVAL);
+	}
+
+	// Appends everything written to it to a string, so that serializing
+	// reuses the string's capacity instead of going through a stringstream.
+	class StringAppendBuffer : public streambuf
+	{
+	public:
+		explicit StringAppendBuffer(string &out) : out_(out) {}
+
+	protected:
+		int_type overflow(int_type c) override
+		{
+			if (!traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				out_.push_back(traits_type::to_char_type(c));
+			}
+			return traits_type::not_eof(c);
+		}
+
+		streamsize xsputn(const char *s, streamsize n) override
+		{
+			out_.append(s, n);
+			return n;
+		}
+
+	private:
+		string &out_;
+	};
+}
+
+bool parseTelemetry(const char *text, size_t length, chrono::steady_clock::time_point received, Telemetry &out)
+{
+	ArenaJson j;
+	{
+		PLANNER_STAGE_SCOPE(STAGE_PARSE);
+		// When a token ends right at the end of its input, the json lexer
+		// copies what is left into a std::string; a little whitespace
+		// after the text keeps that copy within the small string buffer.
+		const size_t LEXER_PADDING = 4;
+		vector<char, ArenaAllocator<char>> padded;
+		padded.reserve(length + LEXER_PADDING);
+		padded.assign(text, text + length);
+		padded.insert(padded.end(), LEXER_PADDING, ' ');
+		j = ArenaJson::parse(padded.begin(), padded.end());
+	}
+	const string *event = j[0].get_ptr<const string *>();
+	if (!event || *event != "telemetry")
+	{
+		return false;
+	}
+	PLANNER_STAGE_SCOPE(STAGE_DECODE);
+	decodeTelemetry(j[1], received, out);
+	return true;
+}
+
+void controlMessage(const Trajectory &trajectory, string &message)
+{
+	PLANNER_STAGE_SCOPE(STAGE_SERIALIZE);
+	ArenaJson msgJson;
+	msgJson["next_x"] = trajectory.x;
+	msgJson["next_y"] = trajectory.y;
+
+	message.assign("42[\"control\",");
+	StringAppendBuffer buffer(message);
+	ostream out(&buffer);
+	out << msgJson;
+	message.push_back(']');
+}
+
+string controlMessage(const Trajectory &trajectory)
+{
+	string message;
+	controlMessage(trajectory, message);
+	return message;
+}
@@ -0,0 +1,41 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "json.hpp"
+#include "planner.h"
+
+// JSON documents whose objects and arrays come from the current arena (see
+// arena.h); used for everything parsed and built within a planning cycle.
+// Strings stay std::string (json 2.1.1 can't parse into another string
+// type), which is no loss: every key and string of the simulator protocol
+// fits into the small string buffer.
+typedef nlohmann::basic_json<std::map, std::vector, std::string, bool, std::int64_t, std::uint64_t, double,
+	ArenaAllocator> ArenaJson;
+
+// Checks if the SocketIO event has JSON data.
+// If there is data the JSON object in string format will be returned,
+// else the empty string "" will be returned.
+std::string hasData(std::string s);
+
+// Same check as hasData(), but only locates the JSON text inside the raw
+// frame instead of copying it out; false if there is none.
+bool findData(const char *data, size_t length, size_t &offset, size_t &size);
+
+// Parses the JSON text of an event (as located by findData()) and, if it is
+// a "telemetry" event, decodes its data object into 'out', reusing its
+// vectors; false for any other event.
+bool parseTelemetry(const char *text, size_t length, std::chrono::steady_clock::time_point received, Telemetry &out);
+
+// Builds the complete "42[\"control\",...]" message for a planned path into
+// 'message', reusing its capacity.
+void controlMessage(const Trajectory &trajectory, std::string &message);
+std::string controlMessage(const Trajectory &trajectory);
+
+#endif // PROTOCOL_H
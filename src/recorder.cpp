@@ -0,0 +1,166 @@
+#include "recorder.h"
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+// Wake the writer early once this much is buffered ...
+static const size_t FLUSH_THRESHOLD = 256 * 1024;
+// ... and drop records rather than grow beyond this if the disk stalls.
+static const size_t MAX_PENDING = 64 * 1024 * 1024;
+
+TelemetryRecorder::TelemetryRecorder()
+	: file_(nullptr), stopping_(false), records_written_(0), records_dropped_(0)
+{
+}
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+	close();
+}
+
+bool TelemetryRecorder::open(const string &path)
+{
+	close();
+	file_ = fopen(path.c_str(), "wb");
+	if (!file_)
+	{
+		return false;
+	}
+
+	started_ = chrono::steady_clock::now();
+	LogFileHeader header;
+	memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+	header.started_unix_ns = chrono::duration_cast<chrono::nanoseconds>(
+		chrono::system_clock::now().time_since_epoch()).count();
+	fwrite(&header, sizeof(header), 1, file_);
+
+	pending_.reserve(FLUSH_THRESHOLD * 2);
+	stopping_ = false;
+	writer_ = thread(&TelemetryRecorder::run, this);
+	return true;
+}
+
+void TelemetryRecorder::close()
+{
+	if (!file_)
+	{
+		return;
+	}
+	{
+		lock_guard<mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	wakeup_.notify_one();
+	writer_.join();
+	fclose(file_);
+	file_ = nullptr;
+}
+
+void TelemetryRecorder::record(LogRecordKind kind, uint64_t session, uint64_t sequence,
+	chrono::steady_clock::time_point when, const char *data, size_t length)
+{
+	if (!file_)
+	{
+		return;
+	}
+
+	LogRecordHeader header;
+	header.length = length;
+	header.kind = kind;
+	header.reserved = 0;
+	header.session = session;
+	header.sequence = sequence;
+	header.timestamp_ns = chrono::duration_cast<chrono::nanoseconds>(when - started_).count();
+
+	bool crossed;
+	{
+		lock_guard<mutex> lock(mutex_);
+		if (pending_.size() + sizeof(header) + length > MAX_PENDING)
+		{
+			records_dropped_++;
+			return;
+		}
+		const char *h = reinterpret_cast<const char *>(&header);
+		pending_.insert(pending_.end(), h, h + sizeof(header));
+		pending_.insert(pending_.end(), data, data + length);
+		// Only the record crossing the threshold pays for the wakeup.
+		crossed = pending_.size() >= FLUSH_THRESHOLD && pending_.size() - sizeof(header) - length < FLUSH_THRESHOLD;
+	}
+	records_written_++;
+	if (crossed)
+	{
+		wakeup_.notify_one();
+	}
+}
+
+void TelemetryRecorder::run()
+{
+	vector<char> writing;
+	writing.reserve(FLUSH_THRESHOLD * 2);
+	bool stopping = false;
+	while (!stopping)
+	{
+		{
+			unique_lock<mutex> lock(mutex_);
+			wakeup_.wait_for(lock, chrono::milliseconds(100),
+				[this] { return stopping_ || pending_.size() >= FLUSH_THRESHOLD; });
+			stopping = stopping_;
+			writing.swap(pending_);
+		}
+		if (!writing.empty())
+		{
+			if (fwrite(writing.data(), 1, writing.size(), file_) != writing.size())
+			{
+				cerr << "Telemetry recorder: write failed" << endl;
+			}
+			writing.clear();
+		}
+	}
+	fflush(file_);
+}
+
+TelemetryLogReader::TelemetryLogReader() : file_(nullptr)
+{
+	memset(&file_header_, 0, sizeof(file_header_));
+}
+
+TelemetryLogReader::~TelemetryLogReader()
+{
+	if (file_)
+	{
+		fclose(file_);
+	}
+}
+
+bool TelemetryLogReader::open(const string &path)
+{
+	if (file_)
+	{
+		fclose(file_);
+		file_ = nullptr;
+	}
+	file_ = fopen(path.c_str(), "rb");
+	if (!file_)
+	{
+		return false;
+	}
+	if (fread(&file_header_, sizeof(file_header_), 1, file_) != 1 ||
+		memcmp(file_header_.magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0)
+	{
+		fclose(file_);
+		file_ = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool TelemetryLogReader::next(LogRecordHeader &header, string &payload)
+{
+	if (!file_ || fread(&header, sizeof(header), 1, file_) != 1)
+	{
+		return false;
+	}
+	payload.resize(header.length);
+	return header.length == 0 || fread(&payload[0], 1, header.length, file_) == header.length;
+}
@@ -0,0 +1,108 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Telemetry log layout (host byte order, append-only):
+//
+//   LogFileHeader
+//   { LogRecordHeader, payload[length] } ...
+//
+// Inbound records hold the raw websocket frame exactly as received, outbound
+// records the message we sent back. 'sequence' numbers the inbound frames of
+// a session; an outbound record carries the sequence of the frame it answers.
+static const char LOG_MAGIC[8] = {'P', 'P', 'L', 'O', 'G', '0', '0', '1'};
+
+struct LogFileHeader
+{
+	char magic[8];
+	int64_t started_unix_ns;  // wall clock time of timestamp_ns == 0
+};
+
+enum LogRecordKind : uint16_t
+{
+	LOG_INBOUND_FRAME = 1,
+	LOG_OUTBOUND_MESSAGE = 2,
+	LOG_SESSION_OPEN = 3     // no payload; when the simulator connected
+};
+
+struct LogRecordHeader
+{
+	uint32_t length;
+	uint16_t kind;
+	uint16_t reserved;
+	uint64_t session;
+	uint64_t sequence;
+	int64_t timestamp_ns;  // steady clock, relative to the start of the log
+};
+
+// Appends records to a telemetry log from any thread. record() only copies
+// into an in-memory buffer; a writer thread flushes it to disk, so callers
+// never wait for I/O. If the disk falls too far behind records are dropped
+// (and counted) instead of blocking the socket loop.
+class TelemetryRecorder
+{
+public:
+	TelemetryRecorder();
+	~TelemetryRecorder();
+
+	bool open(const std::string &path);
+	void close();
+	bool isOpen() const { return file_ != nullptr; }
+
+	void record(LogRecordKind kind, uint64_t session, uint64_t sequence, const char *data, size_t length)
+	{
+		record(kind, session, sequence, std::chrono::steady_clock::now(), data, length);
+	}
+	// Records with the time the caller also hands to the planner, so that
+	// a replay sees exactly the clock the live planner saw.
+	void record(LogRecordKind kind, uint64_t session, uint64_t sequence,
+		std::chrono::steady_clock::time_point when, const char *data, size_t length);
+
+	uint64_t recordsWritten() const { return records_written_.load(); }
+	uint64_t recordsDropped() const { return records_dropped_.load(); }
+
+private:
+	void run();
+
+	FILE *file_;
+	std::chrono::steady_clock::time_point started_;
+	std::thread writer_;
+
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+	std::vector<char> pending_;
+	bool stopping_;
+
+	std::atomic<uint64_t> records_written_;
+	std::atomic<uint64_t> records_dropped_;
+};
+
+// Sequential reader for logs written by TelemetryRecorder.
+class TelemetryLogReader
+{
+public:
+	TelemetryLogReader();
+	~TelemetryLogReader();
+
+	bool open(const std::string &path);
+	// Reads the next record; returns false at the end of the log or on a
+	// truncated trailing record.
+	bool next(LogRecordHeader &header, std::string &payload);
+
+	const LogFileHeader &fileHeader() const { return file_header_; }
+
+private:
+	FILE *file_;
+	LogFileHeader file_header_;
+};
+
+#endif // RECORDER_H
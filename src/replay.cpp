@@ -0,0 +1,412 @@
+// Drives the planner from a telemetry log recorded with
+// "path_planning --record FILE", without any networking, as fast as possible.
+//
+// Usage: path_planning_replay [--map FILE] [--all-frames] [--repeat N] [--trace FILE] [--perf]
+//                             [--planner rules|costs] [--eval-threads N] [--generator spline|jmt]
+//                             [--speed steps|profile] [--lanes N] [--lane-width M] [--dynamic-lanes] LOG
+//
+// By default only the frames that were answered live are planned (the worker
+// pool may have coalesced others away), so that the planner state evolves as
+// it did live and the output can be diffed against the recorded responses.
+// --all-frames plans every inbound telemetry frame instead. --trace writes the
+// last cycles as a Chrome trace (see tracer.h), --perf adds hardware counter
+// totals per stage (see perf_counters.h). --planner costs replays with the
+// cost-function behaviour planner (see behavior_planner.h), which only
+// matches logs recorded with it; the same goes for --generator jmt,
+// --speed profile and the road's --lanes and --lane-width. --dynamic-lanes
+// runs the lane change rules on their code for any lane count instead of the
+// one specialised for the road's, which must not change a single lane.
+//
+// Cycles after the first few run under a NoAllocationScope; any heap
+// allocation in one of them fails the replay like a trajectory diff does.
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "alloc_counter.h"
+#include "arena.h"
+#include "behavior_planner.h"
+#include "json.hpp"
+#include "planner.h"
+#include "protocol.h"
+#include "recorder.h"
+#include "stage_timer.h"
+#include "tracer.h"
+
+using namespace std;
+
+// for convenience
+using json = nlohmann::json;
+
+// Cycles allowed to allocate while the reused buffers grow to size.
+static const size_t WARMUP_CYCLES = 16;
+
+struct ReplayFrame
+{
+	uint64_t session;
+	uint64_t sequence;
+	chrono::steady_clock::time_point received;
+	string data;
+	const string *response;  // recorded control message, if any
+};
+
+static void printLatencies(const char *name, const HdrHistogram &h)
+{
+	cout << left << setw(18) << name << right << setw(10) << h.count() << setw(10) << h.mean() / 1000
+		<< setw(10) << h.percentile(50) / 1000.0 << setw(10) << h.percentile(90) / 1000.0
+		<< setw(10) << h.percentile(99) / 1000.0 << setw(10) << h.percentile(99.9) / 1000.0
+		<< setw(10) << h.max() / 1000.0 << endl;
+}
+
+// Counter totals per stage, plus instructions per cycle where both exist.
+static void printPerfCounters()
+{
+	StagePerfTotals totals[STAGE_COUNT];
+	mergeStagePerfCounters(totals);
+	bool ipc = perfCounterAvailable(PERF_COUNTER_CYCLES) && perfCounterAvailable(PERF_COUNTER_INSTRUCTIONS);
+	cout << left << setw(18) << "stage (total)" << right << setw(10) << "count";
+	for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+	{
+		if (perfCounterAvailable((PerfCounter)c))
+		{
+			cout << setw(16) << perfCounterName((PerfCounter)c);
+		}
+	}
+	if (ipc)
+	{
+		cout << setw(8) << "ipc";
+	}
+	cout << endl;
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		if (!totals[i].samples)
+		{
+			continue;
+		}
+		cout << left << setw(18) << stageName((PlannerStage)i) << right << setw(10) << totals[i].samples;
+		for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+		{
+			if (perfCounterAvailable((PerfCounter)c))
+			{
+				cout << setw(16) << totals[i].values[c];
+			}
+		}
+		if (ipc)
+		{
+			uint64_t cycles = totals[i].values[PERF_COUNTER_CYCLES];
+			cout << setw(8) << (cycles ? (double)totals[i].values[PERF_COUNTER_INSTRUCTIONS] / cycles : 0.0);
+		}
+		cout << endl;
+	}
+}
+
+// Heap allocations per stage, in total and per cycle, and the process's
+// peak resident memory.
+static void printAllocations(size_t cycles)
+{
+	StageAllocationTotals totals[STAGE_COUNT];
+	mergeStageAllocations(totals);
+	cout << left << setw(18) << "stage (allocs)" << right << setw(12) << "total" << setw(14) << "bytes"
+		<< setw(12) << "per cycle" << setw(14) << "bytes/cycle" << endl;
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		cout << left << setw(18) << stageName((PlannerStage)i) << right << setw(12) << totals[i].allocations
+			<< setw(14) << totals[i].bytes << setw(12) << (cycles ? (double)totals[i].allocations / cycles : 0.0)
+			<< setw(14) << (cycles ? (double)totals[i].bytes / cycles : 0.0) << endl;
+	}
+	MemoryFootprint memory = processMemory();
+	cout << "peak resident memory " << memory.peak_resident_bytes / (1024.0 * 1024.0) << " MB" << endl;
+}
+
+static bool parseControl(const string &message, vector<double> &next_x, vector<double> &next_y)
+{
+	string s = hasData(message);
+	if (s == "")
+	{
+		return false;
+	}
+	auto j = json::parse(s);
+	if (j[0].get<string>() != "control")
+	{
+		return false;
+	}
+	next_x = j[1]["next_x"].get<vector<double>>();
+	next_y = j[1]["next_y"].get<vector<double>>();
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	string map_file = "../data/highway_map.csv";
+	string log_file;
+	string trace_file;
+	bool all_frames = false;
+	bool perf = false;
+	int repeat = 1;
+	bool cost_planner = false;
+	BehaviorOptions behavior_options;
+	PlannerOptions planner_options;
+	LaneModel lanes;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+		{
+			map_file = argv[++i];
+		}
+		else if (strcmp(argv[i], "--all-frames") == 0)
+		{
+			all_frames = true;
+		}
+		else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+		{
+			repeat = max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--perf") == 0)
+		{
+			perf = true;
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			trace_file = argv[++i];
+		}
+		else if (strcmp(argv[i], "--planner") == 0 && i + 1 < argc)
+		{
+			cost_planner = strcmp(argv[++i], "costs") == 0;
+		}
+		else if (strcmp(argv[i], "--eval-threads") == 0 && i + 1 < argc)
+		{
+			behavior_options.threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--generator") == 0 && i + 1 < argc)
+		{
+			planner_options.generator = strcmp(argv[++i], "jmt") == 0 ? PATH_JMT : PATH_SPLINE;
+		}
+		else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+		{
+			planner_options.speed = strcmp(argv[++i], "profile") == 0 ? SPEED_PROFILE : SPEED_STEPS;
+		}
+		else if (strcmp(argv[i], "--lanes") == 0 && i + 1 < argc)
+		{
+			lanes.count = max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--lane-width") == 0 && i + 1 < argc)
+		{
+			lanes.width = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--dynamic-lanes") == 0)
+		{
+			planner_options.dynamic_lanes = true;
+		}
+		else
+		{
+			log_file = argv[i];
+		}
+	}
+	if (log_file.empty())
+	{
+		cerr << "Usage: " << argv[0] << " [--map FILE] [--all-frames] [--repeat N] [--trace FILE] [--perf]"
+			<< " [--planner rules|costs] [--eval-threads N] [--generator spline|jmt] [--speed steps|profile]"
+			<< " [--lanes N] [--lane-width M] [--dynamic-lanes] LOG" << endl;
+		return -1;
+	}
+
+	MapWaypoints map;
+	if (!loadMap(map_file, map))
+	{
+		cerr << "Failed to load map " << map_file << endl;
+		return -1;
+	}
+	map.lanes = lanes;
+
+	// Load the whole log up front so that no I/O happens while timing.
+	TelemetryLogReader reader;
+	if (!reader.open(log_file))
+	{
+		cerr << "Failed to open telemetry log " << log_file << endl;
+		return -1;
+	}
+	vector<ReplayFrame> frames;
+	std::map<pair<uint64_t, uint64_t>, string> responses;
+	std::map<uint64_t, chrono::steady_clock::time_point> opened;
+	LogRecordHeader header;
+	string payload;
+	while (reader.next(header, payload))
+	{
+		chrono::steady_clock::time_point when(chrono::nanoseconds(header.timestamp_ns));
+		if (header.kind == LOG_INBOUND_FRAME)
+		{
+			frames.push_back(ReplayFrame{header.session, header.sequence, when, payload, nullptr});
+		}
+		else if (header.kind == LOG_OUTBOUND_MESSAGE)
+		{
+			responses[make_pair(header.session, header.sequence)] = payload;
+		}
+		else if (header.kind == LOG_SESSION_OPEN)
+		{
+			opened[header.session] = when;
+		}
+	}
+	for (auto &frame : frames)
+	{
+		auto it = responses.find(make_pair(frame.session, frame.sequence));
+		if (it != responses.end())
+		{
+			frame.response = &it->second;
+		}
+	}
+
+	unique_ptr<BehaviorPlanner> behavior;
+	if (cost_planner)
+	{
+		behavior.reset(new BehaviorPlanner(behavior_options));
+		planner_options.behavior = behavior.get();
+	}
+
+	HdrHistogram cycle_latency;
+	size_t cycles = 0;
+	size_t compared = 0;
+	size_t differing = 0;
+	double max_deviation = 0;
+	size_t unexpected_allocations = 0;
+	// What a worker keeps per thread and session in the live server
+	Telemetry telemetry;
+	Trajectory trajectory;
+	Arena arena;
+	string msg;
+	vector<double> recorded_x;
+	vector<double> recorded_y;
+
+	if (perf && !enablePerfCounters())
+	{
+		cerr << "No performance counters available, ignoring --perf" << endl;
+		perf = false;
+	}
+	if (!trace_file.empty())
+	{
+		setTraceThreadName("replay");
+		setTracing(true);
+	}
+	auto replay_start = chrono::steady_clock::now();
+	for (int r = 0; r < repeat; r++)
+	{
+		std::map<uint64_t, PlannerState> states;
+		for (const auto &frame : frames)
+		{
+			if (!all_frames && (!frame.response || frame.response->compare(0, 12, "42[\"control\"") != 0))
+			{
+				continue;
+			}
+			auto state = states.find(frame.session);
+			if (state == states.end())
+			{
+				auto o = opened.find(frame.session);
+				state = states.emplace(frame.session, PlannerState(o != opened.end() ? o->second : frame.received)).first;
+			}
+
+			TraceSessionScope trace_session(frame.session, frame.sequence);
+			ScopedTraceEvent trace_cycle("cycle");
+			auto t0 = chrono::steady_clock::now();
+			if (frame.data.size() <= 2 || frame.data[0] != '4' || frame.data[1] != '2')
+			{
+				continue;
+			}
+			PLANNER_STAGE_LAPS(stages);
+			size_t offset = 0;
+			size_t size = 0;
+			bool has_data = findData(frame.data.data(), frame.data.size(), offset, size);
+			PLANNER_STAGE_LAP(stages, STAGE_CLASSIFY);
+			if (!has_data)
+			{
+				continue;
+			}
+			{
+				arena.reset();
+				ArenaScope arena_scope(arena);
+				NoAllocationScope steady_state(cycles >= WARMUP_CYCLES);
+				if (!parseTelemetry(frame.data.data() + offset, size, frame.received, telemetry))
+				{
+					continue;
+				}
+				plan(telemetry, state->second, map, trajectory, planner_options);
+				controlMessage(trajectory, msg);
+				unexpected_allocations += steady_state.unexpectedAllocations();
+			}
+			cycle_latency.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count());
+			cycles++;
+
+			if (r == 0 && frame.response && parseControl(*frame.response, recorded_x, recorded_y))
+			{
+				compared++;
+				double deviation = 0;
+				if (recorded_x.size() != trajectory.x.size())
+				{
+					deviation = INFINITY;
+				}
+				else
+				{
+					for (size_t i = 0; i < recorded_x.size(); i++)
+					{
+						deviation = max(deviation, fabs(recorded_x[i] - trajectory.x[i]));
+						deviation = max(deviation, fabs(recorded_y[i] - trajectory.y[i]));
+					}
+				}
+				if (deviation > 1e-6)
+				{
+					differing++;
+				}
+				max_deviation = max(max_deviation, deviation);
+			}
+		}
+	}
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - replay_start).count();
+	if (!trace_file.empty())
+	{
+		setTracing(false);
+		ofstream trace(trace_file);
+		writeChromeTrace(trace);
+		if (!trace)
+		{
+			cerr << "Failed to write trace " << trace_file << endl;
+		}
+	}
+
+	cout << "replayed " << cycles << " cycles of " << frames.size() << " frames in " << elapsed << " s: "
+		<< (elapsed > 0 ? cycles / elapsed : 0) << " cycles/s" << endl;
+	cout << fixed << setprecision(2);
+	cout << left << setw(18) << "stage (us)" << right << setw(10) << "count" << setw(10) << "mean"
+		<< setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "max" << endl;
+	HdrHistogram stage_latency[STAGE_COUNT];
+	mergeStageHistograms(stage_latency);
+	for (int i = 0; i < STAGE_COUNT; i++)
+	{
+		if (stage_latency[i].count())
+		{
+			printLatencies(stageName((PlannerStage)i), stage_latency[i]);
+		}
+	}
+	printLatencies("cycle", cycle_latency);
+	if (allocationTrackingEnabled())
+	{
+		printAllocations(cycles);
+	}
+	if (perf)
+	{
+		printPerfCounters();
+	}
+	cout << "trajectory diff: " << compared << " compared, " << differing << " differ, max deviation "
+		<< setprecision(6) << max_deviation << " m" << endl;
+	if (allocationTrackingEnabled())
+	{
+		cout << "steady state allocations: " << unexpected_allocations << " in "
+			<< (cycles > WARMUP_CYCLES ? cycles - WARMUP_CYCLES : 0) << " cycles" << endl;
+	}
+	return differing == 0 && unexpected_allocations == 0 ? 0 : 1;
+}
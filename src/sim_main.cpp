@@ -0,0 +1,227 @@
+// Headless stand-in for the term3 simulator. Connects to the planner like
+// the Unity simulator does, sends telemetry, drives along the returned path
+// and answers again as soon as the control message arrives, so simulated
+// time runs as fast as the planner can keep up.
+//
+// Usage: path_planning_sim [--url URL] [--map FILE] [--lanes N] [--lane-width M]
+//                          [--sessions N] [--duration SECONDS] [--ticks K]
+//                          [--vehicles C] [--seed S] [--offline [--record FILE]
+//                          [--planner rules|costs] [--eval-threads N]
+//                          [--generator spline|jmt] [--speed steps|profile]]
+//
+// --lanes and --lane-width describe the road (three 4 m lanes by default),
+// for the simulated traffic and, offline, for the planner. --ticks is the
+// number of path points the car drives between two telemetry messages (the
+// real simulator answers every few ticks). --offline runs the planner
+// in-process instead of connecting to it, and --record then writes the
+// session to a telemetry log for path_planning_replay. --planner costs
+// plans offline with the cost-function behaviour planner, evaluating its
+// candidates on --eval-threads helper threads, --generator jmt lays the
+// path out as jerk minimising trajectories and --speed profile drives a jerk
+// limited speed profile instead of stepping the speed every message.
+#include <uWS/uWS.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "behavior_planner.h"
+#include "highway_sim.h"
+#include "planner.h"
+#include "protocol.h"
+#include "recorder.h"
+
+using namespace std;
+
+struct SimOptions {
+  string url = "ws://127.0.0.1:4567";
+  string map_file = "../data/highway_map.csv";
+  LaneModel lanes;
+  int sessions = 1;
+  double duration = 300;
+  int ticks = 3;
+  int vehicles = 12;
+  unsigned seed = 1;
+  bool offline = false;
+  string record_file;
+  bool cost_planner = false;
+  size_t eval_threads = 0;
+  PathGenerator generator = PATH_SPLINE;
+  SpeedControl speed = SPEED_STEPS;
+};
+
+struct SimClient {
+  int index;
+  unique_ptr<HighwaySim> sim;
+  uint64_t cycles = 0;
+  chrono::steady_clock::time_point started;
+  bool done = false;
+};
+
+static void report(const SimClient &client) {
+  double wall = chrono::duration<double>(chrono::steady_clock::now() - client.started).count();
+  const HighwaySim &sim = *client.sim;
+  cout << "session " << client.index << ": " << client.cycles << " cycles, " << sim.time()
+       << " s simulated in " << wall << " s (" << (wall > 0 ? sim.time() / wall : 0) << "x real time), "
+       << sim.distanceDriven() << " m driven, avg " << (sim.time() > 0 ? sim.distanceDriven() / sim.time() : 0)
+       << " m/s, " << sim.collisions() << " collisions" << endl;
+}
+
+// Runs every session against the planner in this process, no sockets.
+static int runOffline(const SimOptions &options, const MapWaypoints &map) {
+  TelemetryRecorder recorder;
+  if (!options.record_file.empty() && !recorder.open(options.record_file)) {
+    cerr << "Failed to open telemetry log " << options.record_file << endl;
+    return -1;
+  }
+
+  Telemetry decoded;
+  Trajectory trajectory;
+  unique_ptr<BehaviorPlanner> behavior;
+  PlannerOptions planner_options;
+  planner_options.generator = options.generator;
+  planner_options.speed = options.speed;
+  if (options.cost_planner) {
+    BehaviorOptions behavior_options;
+    behavior_options.threads = options.eval_threads;
+    behavior.reset(new BehaviorPlanner(behavior_options));
+    planner_options.behavior = behavior.get();
+  }
+  for (int i = 0; i < options.sessions; i++) {
+    SimClient client;
+    client.index = i;
+    client.sim.reset(new HighwaySim(map, options.seed + i, options.vehicles));
+    client.started = chrono::steady_clock::now();
+
+    // The planner sees simulated time, which keeps recordings replayable.
+    uint64_t session_id = i + 1;
+    chrono::steady_clock::time_point epoch;
+    PlannerState state(epoch);
+    recorder.record(LOG_SESSION_OPEN, session_id, 0, epoch, nullptr, 0);
+    while (client.sim->time() < options.duration) {
+      auto now = epoch + chrono::microseconds((int64_t)(client.sim->time() * 1e6));
+      string telemetry = client.sim->telemetryMessage();
+      recorder.record(LOG_INBOUND_FRAME, session_id, client.cycles, now, telemetry.data(), telemetry.length());
+
+      size_t offset = 0;
+      size_t size = 0;
+      findData(telemetry.data(), telemetry.length(), offset, size);
+      parseTelemetry(telemetry.data() + offset, size, now, decoded);
+      plan(decoded, state, map, trajectory, planner_options);
+      string msg = controlMessage(trajectory);
+      recorder.record(LOG_OUTBOUND_MESSAGE, session_id, client.cycles, now, msg.data(), msg.length());
+
+      client.sim->applyControl(msg);
+      client.sim->advance(options.ticks);
+      client.cycles++;
+    }
+    report(client);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  SimOptions options;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--url" && has_value) {
+      options.url = argv[++i];
+    } else if (arg == "--map" && has_value) {
+      options.map_file = argv[++i];
+    } else if (arg == "--lanes" && has_value) {
+      options.lanes.count = max(1, atoi(argv[++i]));
+    } else if (arg == "--lane-width" && has_value) {
+      options.lanes.width = atof(argv[++i]);
+    } else if (arg == "--sessions" && has_value) {
+      options.sessions = atoi(argv[++i]);
+    } else if (arg == "--duration" && has_value) {
+      options.duration = atof(argv[++i]);
+    } else if (arg == "--ticks" && has_value) {
+      options.ticks = max(1, atoi(argv[++i]));
+    } else if (arg == "--vehicles" && has_value) {
+      options.vehicles = atoi(argv[++i]);
+    } else if (arg == "--seed" && has_value) {
+      options.seed = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--offline") {
+      options.offline = true;
+    } else if (arg == "--record" && has_value) {
+      options.record_file = argv[++i];
+    } else if (arg == "--planner" && has_value) {
+      options.cost_planner = string(argv[++i]) == "costs";
+    } else if (arg == "--eval-threads" && has_value) {
+      options.eval_threads = atoi(argv[++i]);
+    } else if (arg == "--generator" && has_value) {
+      options.generator = string(argv[++i]) == "jmt" ? PATH_JMT : PATH_SPLINE;
+    } else if (arg == "--speed" && has_value) {
+      options.speed = string(argv[++i]) == "profile" ? SPEED_PROFILE : SPEED_STEPS;
+    } else {
+      cerr << "Unknown option " << arg << endl;
+      return -1;
+    }
+  }
+
+  MapWaypoints map;
+  if (!loadMap(options.map_file, map)) {
+    cerr << "Failed to load map " << options.map_file << endl;
+    return -1;
+  }
+  map.lanes = options.lanes;
+
+  if (options.offline) {
+    return runOffline(options, map);
+  }
+
+  uWS::Hub h;
+  vector<unique_ptr<SimClient>> clients;
+  int failed = 0;
+
+  h.onConnection([](uWS::WebSocket<uWS::CLIENT> ws, uWS::HttpRequest req) {
+    SimClient *client = static_cast<SimClient *>(ws.getUserData());
+    client->started = chrono::steady_clock::now();
+    string msg = client->sim->telemetryMessage();
+    ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
+  });
+
+  h.onMessage([&options](uWS::WebSocket<uWS::CLIENT> ws, char *data, size_t length,
+                         uWS::OpCode opCode) {
+    SimClient *client = static_cast<SimClient *>(ws.getUserData());
+    if (client->done || !client->sim->applyControl(string(data, length))) {
+      return;
+    }
+    client->sim->advance(options.ticks);
+    client->cycles++;
+    if (client->sim->time() >= options.duration) {
+      client->done = true;
+      ws.close();
+      return;
+    }
+    string msg = client->sim->telemetryMessage();
+    ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
+  });
+
+  h.onDisconnection([&failed](uWS::WebSocket<uWS::CLIENT> ws, int code, char *message, size_t length) {
+    SimClient *client = static_cast<SimClient *>(ws.getUserData());
+    report(*client);
+    if (!client->done) {
+      failed++;
+    }
+  });
+
+  h.onError([&failed](void *user) {
+    cerr << "session " << static_cast<SimClient *>(user)->index << ": failed to connect" << endl;
+    failed++;
+  });
+
+  for (int i = 0; i < options.sessions; i++) {
+    unique_ptr<SimClient> client(new SimClient);
+    client->index = i;
+    client->sim.reset(new HighwaySim(map, options.seed + i, options.vehicles));
+    h.connect(options.url, client.get());
+    clients.push_back(move(client));
+  }
+  h.run();
+  return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,122 @@
+#include "stage_timer.h"
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	struct StageHistograms
+	{
+		ConcurrentHdrHistogram stages[STAGE_COUNT];
+		SingleWriterCounter perf_samples[STAGE_COUNT];
+		SingleWriterCounter perf[STAGE_COUNT][PERF_COUNTER_COUNT];
+		SingleWriterCounter allocations[STAGE_COUNT];
+		SingleWriterCounter allocated_bytes[STAGE_COUNT];
+	};
+
+	// Histograms outlive their threads so that merged totals never go down.
+	mutex registry_mutex;
+	vector<unique_ptr<StageHistograms>> registry;
+
+	StageHistograms *registerThread()
+	{
+		unique_ptr<StageHistograms> histograms(new StageHistograms);
+		StageHistograms *raw = histograms.get();
+		lock_guard<mutex> lock(registry_mutex);
+		registry.push_back(move(histograms));
+		return raw;
+	}
+}
+
+const char *stageName(PlannerStage stage)
+{
+	static const char *names[STAGE_COUNT] = {
+		"classify", "parse", "decode", "sensor_fusion", "lane_decision",
+		"spline_fit", "point_generation", "serialize", "send"};
+	return stage < STAGE_COUNT ? names[stage] : "unknown";
+}
+
+static StageHistograms &threadHistograms()
+{
+	static thread_local StageHistograms *histograms = registerThread();
+	return *histograms;
+}
+
+ConcurrentHdrHistogram &threadStageHistogram(PlannerStage stage)
+{
+	return threadHistograms().stages[stage];
+}
+
+void recordStagePerf(PlannerStage stage, PerfSample &begin)
+{
+	PerfSample end;
+	readPerfCounters(end);
+	if (!end.valid)
+	{
+		begin.valid = false;
+		return;
+	}
+	StageHistograms &histograms = threadHistograms();
+	histograms.perf_samples[stage].add();
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+	{
+		histograms.perf[stage][i].add(end.values[i] - begin.values[i]);
+	}
+	begin = end;
+}
+
+void recordStageAllocations(PlannerStage stage, AllocationCounts &begin)
+{
+	// Sample before touching the registry, whose first use allocates.
+	AllocationCounts end = threadAllocationCounts();
+	StageHistograms &histograms = threadHistograms();
+	histograms.allocations[stage].add(end.allocations - begin.allocations);
+	histograms.allocated_bytes[stage].add(end.bytes_allocated - begin.bytes_allocated);
+	begin = end;
+}
+
+void mergeStageHistograms(HdrHistogram into[STAGE_COUNT])
+{
+	lock_guard<mutex> lock(registry_mutex);
+	for (const auto &histograms : registry)
+	{
+		for (int i = 0; i < STAGE_COUNT; i++)
+		{
+			histograms->stages[i].snapshotInto(into[i]);
+		}
+	}
+}
+
+void mergeStagePerfCounters(StagePerfTotals into[STAGE_COUNT])
+{
+	memset(into, 0, sizeof(StagePerfTotals) * STAGE_COUNT);
+	lock_guard<mutex> lock(registry_mutex);
+	for (const auto &histograms : registry)
+	{
+		for (int i = 0; i < STAGE_COUNT; i++)
+		{
+			into[i].samples += histograms->perf_samples[i].load();
+			for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+			{
+				into[i].values[c] += histograms->perf[i][c].load();
+			}
+		}
+	}
+}
+
+void mergeStageAllocations(StageAllocationTotals into[STAGE_COUNT])
+{
+	memset(into, 0, sizeof(StageAllocationTotals) * STAGE_COUNT);
+	lock_guard<mutex> lock(registry_mutex);
+	for (const auto &histograms : registry)
+	{
+		for (int i = 0; i < STAGE_COUNT; i++)
+		{
+			into[i].allocations += histograms->allocations[i].load();
+			into[i].bytes += histograms->allocated_bytes[i].load();
+		}
+	}
+}
@@ -0,0 +1,172 @@
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+#include "alloc_counter.h"
+#include "counter.h"
+#include "hdr_histogram.h"
+#include "perf_counters.h"
+#include "tracer.h"
+
+// Stages of one telemetry -> control cycle, one after the other: none of
+// them is timed inside another.
+enum PlannerStage
+{
+	STAGE_CLASSIFY,          // "42" event check and payload extraction
+	STAGE_PARSE,             // json::parse of the payload
+	STAGE_DECODE,            // json to Telemetry
+	STAGE_SENSOR_FUSION,     // sorting, tracking and predicting the other cars
+	STAGE_LANE_DECISION,     // choosing the lane and the speed
+	STAGE_SPLINE_FIT,        // anchor points and tk::spline::set_points
+	STAGE_POINT_GENERATION,  // sampling the spline into path points
+	STAGE_SERIALIZE,         // building the control message
+	STAGE_SEND,              // ws.send on the socket loop
+	STAGE_COUNT
+};
+
+const char *stageName(PlannerStage stage);
+
+// Latency histogram (ns) of 'stage' owned by the calling thread. Each thread
+// gets its own set the first time it records; only that registration takes
+// a lock.
+ConcurrentHdrHistogram &threadStageHistogram(PlannerStage stage);
+
+// Sums the histograms of all threads that ever recorded into 'into'.
+void mergeStageHistograms(HdrHistogram into[STAGE_COUNT]);
+
+// Performance counter totals of one stage, while perf counters are enabled.
+struct StagePerfTotals
+{
+	uint64_t samples;
+	uint64_t values[PERF_COUNTER_COUNT];
+};
+
+// Adds the counter deltas from 'begin' to now against 'stage' (for the
+// calling thread) and leaves the current values in 'begin'.
+void recordStagePerf(PlannerStage stage, PerfSample &begin);
+
+// Sums the counter totals of all threads into 'into' (zeroed first).
+void mergeStagePerfCounters(StagePerfTotals into[STAGE_COUNT]);
+
+// Heap allocations made inside one stage (see alloc_counter.h). Like its
+// time, a stage's allocations include those of the stages nested in it.
+struct StageAllocationTotals
+{
+	uint64_t allocations;
+	uint64_t bytes;
+};
+
+// Adds the calling thread's allocations since 'begin' against 'stage' and
+// leaves the current counts in 'begin'.
+void recordStageAllocations(PlannerStage stage, AllocationCounts &begin);
+
+// Sums the allocation totals of all threads into 'into' (zeroed first).
+void mergeStageAllocations(StageAllocationTotals into[STAGE_COUNT]);
+
+// Records the time from construction to destruction against a stage, as a
+// trace event while tracing is on, its performance counters while those
+// are enabled and its heap allocations with PLANNER_ALLOC_TRACKING.
+class ScopedStageTimer
+{
+public:
+	explicit ScopedStageTimer(PlannerStage stage) : stage_(stage)
+	{
+#ifdef PLANNER_ALLOC_TRACKING
+		alloc_start_ = threadAllocationCounts();
+#endif
+		perf_start_.valid = false;
+		if (perfCountersEnabled())
+		{
+			readPerfCounters(perf_start_);
+		}
+		start_ = std::chrono::steady_clock::now();
+	}
+	~ScopedStageTimer()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+#ifdef PLANNER_ALLOC_TRACKING
+		recordStageAllocations(stage_, alloc_start_);
+#endif
+		threadStageHistogram(stage_).record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count());
+		if (tracingEnabled())
+		{
+			traceEvent(stageName(stage_), start_, now);
+		}
+		if (perf_start_.valid)
+		{
+			recordStagePerf(stage_, perf_start_);
+		}
+	}
+
+private:
+	PlannerStage stage_;
+	std::chrono::steady_clock::time_point start_;
+	PerfSample perf_start_;
+#ifdef PLANNER_ALLOC_TRACKING
+	AllocationCounts alloc_start_;
+#endif
+};
+
+// Times consecutive stages of one function: each lap() records the time
+// since the previous lap (or construction) against the given stage.
+class StageLapTimer
+{
+public:
+	StageLapTimer()
+	{
+#ifdef PLANNER_ALLOC_TRACKING
+		alloc_last_ = threadAllocationCounts();
+#endif
+		perf_last_.valid = false;
+		if (perfCountersEnabled())
+		{
+			readPerfCounters(perf_last_);
+		}
+		last_ = std::chrono::steady_clock::now();
+	}
+	void lap(PlannerStage stage)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+#ifdef PLANNER_ALLOC_TRACKING
+		recordStageAllocations(stage, alloc_last_);
+#endif
+		threadStageHistogram(stage).record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count());
+		if (tracingEnabled())
+		{
+			traceEvent(stageName(stage), last_, now);
+		}
+		last_ = now;
+		if (perf_last_.valid)
+		{
+			// Keep the read(2) out of the next stage's time.
+			recordStagePerf(stage, perf_last_);
+			last_ = std::chrono::steady_clock::now();
+		}
+	}
+
+private:
+	std::chrono::steady_clock::time_point last_;
+	PerfSample perf_last_;
+#ifdef PLANNER_ALLOC_TRACKING
+	AllocationCounts alloc_last_;
+#endif
+};
+
+// PLANNER_STAGE_SCOPE(stage) times the rest of the enclosing block,
+// PLANNER_STAGE_LAPS(name) / PLANNER_STAGE_LAP(name, stage) time a sequence
+// of stages. Without PLANNER_STAGE_TIMING (cmake -DPLANNER_STAGE_TIMING=OFF)
+// they expand to nothing and no clock is read.
+#ifdef PLANNER_STAGE_TIMING
+#define PLANNER_STAGE_CONCAT_(a, b) a##b
+#define PLANNER_STAGE_CONCAT(a, b) PLANNER_STAGE_CONCAT_(a, b)
+#define PLANNER_STAGE_SCOPE(stage) ScopedStageTimer PLANNER_STAGE_CONCAT(stage_timer_, __LINE__)(stage)
+#define PLANNER_STAGE_LAPS(name) StageLapTimer name
+#define PLANNER_STAGE_LAP(name, stage) name.lap(stage)
+#else
+#define PLANNER_STAGE_SCOPE(stage) ((void)0)
+#define PLANNER_STAGE_LAPS(name) ((void)0)
+#define PLANNER_STAGE_LAP(name, stage) ((void)0)
+#endif
+
+#endif // STAGE_TIMER_H
@@ -0,0 +1,190 @@
+#include "swept_collision.h"
+#include <math.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+	// LANES floats, and the masks comparing them gives, as GCC/Clang vector
+	// extensions: the compiler maps them onto whatever vector registers the
+	// target has (one SSE or NEON register each).
+	typedef float FloatBlock __attribute__((vector_size(SweptCollisionChecker::LANES * sizeof(float))));
+	typedef int32_t MaskBlock __attribute__((vector_size(SweptCollisionChecker::LANES * sizeof(int32_t))));
+
+	// Where the padding cars are, relative to the car (m): farther than any
+	// trajectory gets.
+	const float FAR_AWAY = 1e6f;
+
+	// The columns are only float aligned.
+	FloatBlock load(const float *from)
+	{
+		FloatBlock block;
+		memcpy(&block, from, sizeof(block));
+		return block;
+	}
+
+	FloatBlock absolute(FloatBlock x)
+	{
+		return (FloatBlock)((MaskBlock)x & 0x7fffffff);
+	}
+
+	bool any(MaskBlock mask)
+	{
+#ifdef __SSE__
+		// The sign bits in one instruction rather than lane by lane.
+		return __builtin_ia32_movmskps((FloatBlock)mask) != 0;
+#else
+		for (int i = 0; i < SweptCollisionChecker::LANES; i++)
+		{
+			if (mask[i])
+			{
+				return true;
+			}
+		}
+		return false;
+#endif
+	}
+
+	// Direction of a motion by 'ds', 'dd'; along the road if there is
+	// hardly any motion.
+	void heading(double ds, double dd, float &along, float &across)
+	{
+		double length = sqrt(ds * ds + dd * dd);
+		if (length < 1e-3)
+		{
+			along = 1;
+			across = 0;
+			return;
+		}
+		along = ds / length;
+		across = dd / length;
+	}
+
+	bool followsCar(const VehicleTable &vehicles, const LaneModel &lanes, int row, double s, int lane)
+	{
+		return vehicles.predicted_s[row] < s && lanes.laneOf(vehicles.d[row]) == lane;
+	}
+}
+
+SweptCollisionChecker::SweptCollisionChecker(double length, double width)
+	: half_length_(length / 2), half_width_(width / 2), steps_(0), stride_(0), origin_(0)
+{
+}
+
+void SweptCollisionChecker::build(const VehicleTable &vehicles, const PredictionBuffer &prediction,
+	const LaneModel &lanes, double s, int lane)
+{
+	const int n = prediction.count;
+	order_.clear();
+	for (int i = 0; i < n; i++)
+	{
+		if (!followsCar(vehicles, lanes, i, s, lane))
+		{
+			order_.push_back(i);
+		}
+	}
+	// By s, so that the cars of a block are near each other and mostly all
+	// far from a trajectory at once.
+	if (prediction.steps > 0)
+	{
+		sort(order_.begin(), order_.end(),
+			[&prediction](int a, int b) { return prediction.s(0, a) < prediction.s(0, b); });
+	}
+	origin_ = s;
+	steps_ = prediction.steps;
+	stride_ = ((int)order_.size() + LANES - 1) / LANES * LANES;
+	const size_t cells = (size_t)steps_ * stride_;
+	mid_s_.assign(cells, FAR_AWAY);
+	mid_d_.assign(cells, 0);
+	move_s_.assign(cells, 0);
+	move_d_.assign(cells, 0);
+	cos_.assign(cells, 1);
+	sin_.assign(cells, 0);
+
+	for (size_t column = 0; column < order_.size(); column++)
+	{
+		const int i = order_[column];
+		// Before the first step: where the motion of the first step puts it.
+		double from_s = prediction.s(0, i);
+		double from_d = prediction.d(0, i);
+		if (steps_ > 1)
+		{
+			from_s -= prediction.s(1, i) - from_s;
+			from_d -= prediction.d(1, i) - from_d;
+		}
+		for (int k = 0; k < steps_; k++)
+		{
+			const double to_s = prediction.s(k, i);
+			const double to_d = prediction.d(k, i);
+			const size_t cell = (size_t)k * stride_ + column;
+			mid_s_[cell] = (from_s + to_s) / 2 - s;
+			mid_d_[cell] = (from_d + to_d) / 2;
+			move_s_[cell] = to_s - from_s;
+			move_d_[cell] = to_d - from_d;
+			heading(to_s - from_s, to_d - from_d, cos_[cell], sin_[cell]);
+			from_s = to_s;
+			from_d = to_d;
+		}
+	}
+}
+
+int SweptCollisionChecker::firstCollision(const double *s, const double *d, int steps, double s0, double d0) const
+{
+	steps = min(steps, steps_);
+	const float hl = half_length_;
+	const float hw = half_width_;
+	double from_s = s0;
+	double from_d = d0;
+	for (int k = 0; k < steps; k++)
+	{
+		const float mid_s = (from_s + s[k]) / 2 - origin_;
+		const float mid_d = (from_d + d[k]) / 2;
+		const float move_s = s[k] - from_s;
+		const float move_d = d[k] - from_d;
+		float ux;
+		float uy;
+		heading(move_s, move_d, ux, uy);
+		from_s = s[k];
+		from_d = d[k];
+
+		// In the frame of the other car, the car moves by r over the step
+		// and its box sweeps a box around c, the midpoint of that motion,
+		// with the car's axes u and v, grown by half of r along each. The
+		// boxes touch unless one of the four axes separates them.
+		const size_t row = (size_t)k * stride_;
+		for (int first = 0; first < stride_; first += LANES)
+		{
+			const size_t at = row + first;
+			const FloatBlock cx = mid_s - load(&mid_s_[at]);
+			const FloatBlock cy = mid_d - load(&mid_d_[at]);
+			const FloatBlock rx = move_s - load(&move_s_[at]);
+			const FloatBlock ry = move_d - load(&move_d_[at]);
+			// Half extents of the swept box.
+			const FloatBlock a = hl + absolute(rx * ux + ry * uy) * 0.5f;
+			const FloatBlock b = hw + absolute(ry * ux - rx * uy) * 0.5f;
+			// Most blocks are out of reach of either box in any orientation.
+			const FloatBlock reach = a + b + (hl + hw);
+			if (!any((absolute(cx) <= reach) & (absolute(cy) <= reach)))
+			{
+				continue;
+			}
+			const FloatBlock other_cos = load(&cos_[at]);
+			const FloatBlock other_sin = load(&sin_[at]);
+			// |cos| and |sin| of the angle between the headings.
+			const FloatBlock p = absolute(other_cos * ux + other_sin * uy);
+			const FloatBlock q = absolute(other_sin * ux - other_cos * uy);
+			MaskBlock apart = absolute(cx * ux + cy * uy) > a + hl * p + hw * q;
+			apart |= absolute(cy * ux - cx * uy) > b + hl * q + hw * p;
+			apart |= absolute(cx * other_cos + cy * other_sin) > a * p + b * q + hl;
+			apart |= absolute(cy * other_cos - cx * other_sin) > a * q + b * p + hw;
+			if (any(~apart))
+			{
+				return k;
+			}
+		}
+	}
+	return -1;
+}
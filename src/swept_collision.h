@@ -0,0 +1,60 @@
+#ifndef SWEPT_COLLISION_H
+#define SWEPT_COLLISION_H
+
+#include <vector>
+#include "lane_occupancy.h"
+#include "prediction.h"
+#include "vehicle_table.h"
+
+// Exact collision checks of sampled trajectories against the predicted
+// cars: at every step the car's footprint, swept over the motion since the
+// previous step, is tested against the oriented footprint of every other car
+// at the same step with the separating axis test. Boxes are oriented along
+// each car's direction of travel in the (s, d) plane, which is flat enough
+// on a highway's curves.
+//
+// The predictions are laid out per step as columns of floats relative to the
+// car's s (midpoint, motion and heading of every car), padded to whole
+// blocks of LANES cars with cars far away; a step is then tested one block at
+// a time with vector instructions, and a trajectory stops at the first block
+// with a hit. Rebuilt every frame; reusing an instance keeps its capacity.
+class SweptCollisionChecker
+{
+public:
+	// Cars tested at once.
+	static const int LANES = 4;
+
+	// 'length' and 'width' are the footprint of a car (m).
+	explicit SweptCollisionChecker(double length = 5, double width = 2);
+
+	// Takes in the cars of 'prediction', relative to 's'. Cars that are
+	// behind 's' in 'lane' are left out, like in the rollouts: a car
+	// following the car has to keep its own distance.
+	void build(const VehicleTable &vehicles, const PredictionBuffer &prediction, const LaneModel &lanes, double s,
+		int lane);
+
+	int steps() const { return steps_; }
+
+	// The first step at which a car driving from 's0', 'd0' through the
+	// 'steps' samples 's', 'd' (one per prediction step) touches another
+	// car, -1 if it touches none.
+	int firstCollision(const double *s, const double *d, int steps, double s0, double d0) const;
+
+private:
+	float half_length_;
+	float half_width_;
+	int steps_;
+	int stride_;     // cars per step, padded to LANES
+	double origin_;  // s the columns are relative to
+	// [step * stride_ + car]: the midpoint of the car's motion over the
+	// step, that motion, and the cosine and sine of its heading.
+	std::vector<float> mid_s_;
+	std::vector<float> mid_d_;
+	std::vector<float> move_s_;
+	std::vector<float> move_d_;
+	std::vector<float> cos_;
+	std::vector<float> sin_;
+	std::vector<int> order_;  // rows of the cars taken in, by s
+};
+
+#endif // SWEPT_COLLISION_H
@@ -0,0 +1,181 @@
+#include "tracer.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace tracing
+{
+	atomic<bool> enabled(false);
+}
+
+namespace
+{
+	// Events kept per thread; at 40 bytes each about 2.5 MB, several seconds
+	// of planning even on the busiest thread. The slots are left
+	// uninitialised, so a ring takes no memory until events are written.
+	const uint64_t RING_CAPACITY = 1 << 16;
+
+	// Fields are relaxed atomics so that a dump running next to the owning
+	// thread reads torn slots (which it then discards) instead of racing.
+	struct TraceSlot
+	{
+		atomic<const char *> name;
+		atomic<int64_t> begin_ns;
+		atomic<int64_t> duration_ns;
+		atomic<uint64_t> session;
+		atomic<uint64_t> sequence;
+	};
+
+	struct ThreadTrace
+	{
+		int tid;
+		char thread_name[32];
+		atomic<uint64_t> head;  // events ever recorded; the next slot is head % RING_CAPACITY
+		TraceSlot slots[RING_CAPACITY];
+	};
+
+	struct TraceEventCopy
+	{
+		const char *name;
+		int64_t begin_ns;
+		int64_t duration_ns;
+		uint64_t session;
+		uint64_t sequence;
+	};
+
+	const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+	// Buffers outlive their threads so that a dump still shows finished ones.
+	mutex registry_mutex;
+	vector<unique_ptr<ThreadTrace>> registry;
+
+	thread_local ThreadTrace *thread_trace = nullptr;
+	thread_local char thread_name[32] = "";
+	thread_local uint64_t current_session = 0;
+	thread_local uint64_t current_sequence = 0;
+
+	ThreadTrace *registerThread()
+	{
+		unique_ptr<ThreadTrace> trace(new ThreadTrace);
+		trace->head.store(0);
+		strncpy(trace->thread_name, thread_name, sizeof(trace->thread_name));
+		ThreadTrace *raw = trace.get();
+		lock_guard<mutex> lock(registry_mutex);
+		raw->tid = (int)registry.size() + 1;
+		registry.push_back(move(trace));
+		return raw;
+	}
+
+	int64_t sinceEpoch(chrono::steady_clock::time_point t)
+	{
+		return chrono::duration_cast<chrono::nanoseconds>(t - epoch).count();
+	}
+
+	void writeMicroseconds(ostream &out, int64_t ns)
+	{
+		ns = max<int64_t>(ns, 0);
+		out << ns / 1000 << '.' << setw(3) << setfill('0') << ns % 1000 << setfill(' ');
+	}
+}
+
+void setTracing(bool on)
+{
+	tracing::enabled.store(on);
+}
+
+void setTraceThreadName(const char *name)
+{
+	strncpy(thread_name, name, sizeof(thread_name) - 1);
+	if (!thread_trace)
+	{
+		// Named threads are the ones that plan; with the ring in place now,
+		// switching tracing on later doesn't allocate inside their cycles.
+		thread_trace = registerThread();
+		return;
+	}
+	lock_guard<mutex> lock(registry_mutex);
+	strncpy(thread_trace->thread_name, thread_name, sizeof(thread_trace->thread_name));
+}
+
+void traceEvent(const char *name, chrono::steady_clock::time_point begin, chrono::steady_clock::time_point end)
+{
+	if (!tracingEnabled())
+	{
+		return;
+	}
+	if (!thread_trace)
+	{
+		thread_trace = registerThread();
+	}
+	uint64_t head = thread_trace->head.load(memory_order_relaxed);
+	TraceSlot &slot = thread_trace->slots[head % RING_CAPACITY];
+	slot.name.store(name, memory_order_relaxed);
+	slot.begin_ns.store(sinceEpoch(begin), memory_order_relaxed);
+	slot.duration_ns.store(chrono::duration_cast<chrono::nanoseconds>(end - begin).count(), memory_order_relaxed);
+	slot.session.store(current_session, memory_order_relaxed);
+	slot.sequence.store(current_sequence, memory_order_relaxed);
+	thread_trace->head.store(head + 1, memory_order_release);
+}
+
+TraceSessionScope::TraceSessionScope(uint64_t session, uint64_t sequence)
+	: previous_session_(current_session), previous_sequence_(current_sequence)
+{
+	current_session = session;
+	current_sequence = sequence;
+}
+
+TraceSessionScope::~TraceSessionScope()
+{
+	current_session = previous_session_;
+	current_sequence = previous_sequence_;
+}
+
+void writeChromeTrace(ostream &out)
+{
+	lock_guard<mutex> lock(registry_mutex);
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"path_planning\"}}";
+	vector<TraceEventCopy> events;
+	for (const auto &trace : registry)
+	{
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trace->tid
+			<< ",\"args\":{\"name\":\"" << (trace->thread_name[0] ? trace->thread_name : "thread") << "\"}}";
+
+		// Copy the ring, then drop whatever the owner may have overwritten
+		// while we were reading it.
+		uint64_t head = trace->head.load(memory_order_acquire);
+		uint64_t first = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+		events.clear();
+		for (uint64_t i = first; i < head; i++)
+		{
+			const TraceSlot &slot = trace->slots[i % RING_CAPACITY];
+			events.push_back(TraceEventCopy{slot.name.load(memory_order_relaxed), slot.begin_ns.load(memory_order_relaxed),
+				slot.duration_ns.load(memory_order_relaxed), slot.session.load(memory_order_relaxed),
+				slot.sequence.load(memory_order_relaxed)});
+		}
+		atomic_thread_fence(memory_order_acquire);
+		uint64_t head_after = trace->head.load(memory_order_relaxed);
+		uint64_t valid = head_after > RING_CAPACITY + 1 ? head_after - RING_CAPACITY + 1 : 0;
+
+		for (uint64_t i = max(first, valid); i < head; i++)
+		{
+			const TraceEventCopy &e = events[i - first];
+			out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"planner\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace->tid
+				<< ",\"ts\":";
+			writeMicroseconds(out, e.begin_ns);
+			out << ",\"dur\":";
+			writeMicroseconds(out, e.duration_ns);
+			if (e.session)
+			{
+				out << ",\"args\":{\"session\":" << e.session << ",\"sequence\":" << e.sequence << "}";
+			}
+			out << "}";
+		}
+	}
+	out << "\n]}\n";
+}
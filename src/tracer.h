@@ -0,0 +1,82 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Switchable event tracer for looking at individual planning cycles. While
+// enabled, every timed stage and every worker cycle is recorded as a
+// complete event (begin time and duration) into a ring buffer of the calling
+// thread, tagged with the session and frame being processed. The buffers can
+// be written out as Chrome trace-event JSON for Perfetto (ui.perfetto.dev)
+// or chrome://tracing.
+//
+// Disabled, recording costs one relaxed load. Enabled, it is a few relaxed
+// stores into memory owned by the thread. A thread's buffer is registered
+// (under a lock, on the heap) when it names itself, or else with its first
+// event.
+
+namespace tracing
+{
+	extern std::atomic<bool> enabled;
+}
+
+inline bool tracingEnabled()
+{
+	return tracing::enabled.load(std::memory_order_relaxed);
+}
+
+void setTracing(bool on);
+
+// Name shown for the calling thread's track. Threads that plan call this
+// when they start, so that turning tracing on later never allocates inside
+// a planning cycle.
+void setTraceThreadName(const char *name);
+
+// Records an event named 'name' (must be a string literal or otherwise
+// outlive the tracer) from 'begin' to 'end' on the calling thread.
+void traceEvent(const char *name, std::chrono::steady_clock::time_point begin,
+	std::chrono::steady_clock::time_point end);
+
+// Writes the events still held by all ring buffers as a Chrome trace.
+void writeChromeTrace(std::ostream &out);
+
+// Tags the events recorded by this thread while in scope with a session and
+// frame sequence number.
+class TraceSessionScope
+{
+public:
+	TraceSessionScope(uint64_t session, uint64_t sequence);
+	~TraceSessionScope();
+
+private:
+	uint64_t previous_session_;
+	uint64_t previous_sequence_;
+};
+
+// Records the time from construction to destruction as an event, if tracing
+// was enabled at construction.
+class ScopedTraceEvent
+{
+public:
+	explicit ScopedTraceEvent(const char *name)
+		: name_(tracingEnabled() ? name : nullptr),
+		  begin_(name_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+	{
+	}
+	~ScopedTraceEvent()
+	{
+		if (name_)
+		{
+			traceEvent(name_, begin_, std::chrono::steady_clock::now());
+		}
+	}
+
+private:
+	const char *name_;
+	std::chrono::steady_clock::time_point begin_;
+};
+
+#endif // TRACER_H
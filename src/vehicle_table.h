@@ -0,0 +1,82 @@
+#ifndef VEHICLE_TABLE_H
+#define VEHICLE_TABLE_H
+
+#include <math.h>
+#include <cstddef>
+#include <vector>
+
+// The sensor fusion list of one frame, one column per field of
+// [id, x, y, vx, vy, s, d] plus the derived speed and predicted s. Decoded
+// once per frame; the lane logic scans whole columns instead of picking
+// fields out of the json, and every car's speed is computed only once.
+// Reusing an instance keeps the capacity of its columns.
+struct VehicleTable
+{
+	std::vector<int> id;
+	std::vector<double> x;
+	std::vector<double> y;
+	std::vector<double> vx;
+	std::vector<double> vy;
+	std::vector<double> s;
+	std::vector<double> d;
+	std::vector<double> speed;        // m/s, sqrt(vx^2 + vy^2)
+	std::vector<double> predicted_s;  // s after the horizon of predict()
+
+	size_t size() const { return id.size(); }
+
+	void reserve(size_t n)
+	{
+		id.reserve(n);
+		x.reserve(n);
+		y.reserve(n);
+		vx.reserve(n);
+		vy.reserve(n);
+		s.reserve(n);
+		d.reserve(n);
+		speed.reserve(n);
+		predicted_s.reserve(n);
+	}
+
+	void clear()
+	{
+		id.clear();
+		x.clear();
+		y.clear();
+		vx.clear();
+		vy.clear();
+		s.clear();
+		d.clear();
+		speed.clear();
+		predicted_s.clear();
+	}
+
+	void add(int car_id, double car_x, double car_y, double car_vx, double car_vy, double car_s, double car_d)
+	{
+		id.push_back(car_id);
+		x.push_back(car_x);
+		y.push_back(car_y);
+		vx.push_back(car_vx);
+		vy.push_back(car_vy);
+		s.push_back(car_s);
+		d.push_back(car_d);
+		speed.push_back(sqrt(car_vx * car_vx + car_vy * car_vy));
+	}
+
+	// Fills predicted_s with where every car will be after 'seconds' at
+	// constant speed along its lane. One branch-free pass over contiguous
+	// columns, which the compiler vectorises.
+	void predict(double seconds)
+	{
+		size_t n = size();
+		predicted_s.resize(n);
+		const double *from = s.data();
+		const double *v = speed.data();
+		double *to = predicted_s.data();
+		for (size_t i = 0; i < n; i++)
+		{
+			to[i] = from[i] + seconds * v[i];
+		}
+	}
+};
+
+#endif // VEHICLE_TABLE_H
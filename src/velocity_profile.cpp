@@ -0,0 +1,61 @@
+#include "velocity_profile.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace std;
+
+double advanceProfile(SpeedState &state, double target, double dt, const SpeedLimits &limits)
+{
+	const double v = state.speed;
+	const double a = state.acceleration;
+	const double j = limits.jerk;
+	// Bringing an acceleration a' back to zero at the jerk limit adds
+	// a'|a'| / 2j to the speed. The acceleration to end the step with is the
+	// one after which that lands exactly on the target:
+	// c + a' dt / 2 + a'|a'| / 2j = 0, with c the rest of the step's change.
+	const double c = v + a * dt / 2 - target;
+	double next;
+	if (c <= 0)
+	{
+		next = j * (sqrt(dt * dt / 4 - 2 * c / j) - dt / 2);
+	}
+	else
+	{
+		next = (j * dt - sqrt(j * j * dt * dt + 8 * j * c)) / 2;
+	}
+	next = min(next, min(a + j * dt, limits.acceleration));
+	next = max(next, max(a - j * dt, -limits.deceleration));
+
+	double covered = v * dt + (2 * a + next) * dt * dt / 6;
+	state.speed = v + (a + next) * dt / 2;
+	state.acceleration = next;
+	if (state.speed < 0)
+	{
+		// Stopped within the step.
+		state.speed = 0;
+		state.acceleration = 0;
+		covered = max(covered, 0.0);
+	}
+	return covered;
+}
+
+void sampleProfile(SpeedState &state, double target, double dt, int n, const SpeedLimits &limits, double *distance)
+{
+	double covered = 0;
+	for (int i = 0; i < n; i++)
+	{
+		covered += advanceProfile(state, target, dt, limits);
+		distance[i] = covered;
+	}
+}
+
+double followingSpeed(double gap, double leader_speed, double min_gap, const SpeedLimits &limits)
+{
+	// Closing in at w, braking at b takes w^2 / 2b of the gap, plus up to
+	// w b / j while the deceleration ramps up; w is where that uses up the
+	// room.
+	const double room = max(0.0, gap - min_gap);
+	const double b = limits.deceleration;
+	const double ramp = b * b / limits.jerk;
+	return leader_speed + sqrt(ramp * ramp + 2 * b * room) - ramp;
+}
@@ -0,0 +1,39 @@
+#ifndef VELOCITY_PROFILE_H
+#define VELOCITY_PROFILE_H
+
+// Jerk and acceleration limited speed profiles ("S-curves"): the speed runs
+// towards a target with the acceleration ramped up and down at a bounded
+// jerk, and arrives at the target with no acceleration left. The profile is
+// a step law, advanced one path point at a time, so a path continued from
+// the state at its end is the same however often it is replanned.
+
+struct SpeedLimits
+{
+	double acceleration = 5;  // m/s^2
+	double deceleration = 7;  // m/s^2
+	double jerk = 7;          // m/s^3
+};
+
+// Speed and acceleration at one point of a profile.
+struct SpeedState
+{
+	double speed;         // m/s
+	double acceleration;  // m/s^2
+};
+
+// Advances 'state' by 'dt' towards 'target' (m/s) and returns the distance
+// covered. The acceleration changes linearly over the step: as fast as the
+// limits let the speed approach the target, but no faster than it can still
+// be brought back to zero on arrival.
+double advanceProfile(SpeedState &state, double target, double dt, const SpeedLimits &limits);
+
+// Advances 'state' by 'n' steps of 'dt' towards 'target' and writes the
+// distance covered after each step to distance[0..n).
+void sampleProfile(SpeedState &state, double target, double dt, int n, const SpeedLimits &limits, double *distance);
+
+// The highest speed from which the car can still slow down to 'leader_speed'
+// before the 'gap' (m) to a car ahead shrinks below 'min_gap', braking at
+// the limits' deceleration after ramping up to it.
+double followingSpeed(double gap, double leader_speed, double min_gap, const SpeedLimits &limits);
+
+#endif // VELOCITY_PROFILE_H
@@ -0,0 +1,279 @@
+#include "worker_pool.h"
+#include "alloc_counter.h"
+#include "tracer.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+WorkerPool::WorkerPool(size_t threads, Handler handler, function<void()> notify)
+	: handler_(handler), notify_(notify), stopping_(false), completions_(nullptr), next_session_id_(1)
+{
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+	for (size_t i = 0; i < threads; i++)
+	{
+		worker_counters_.emplace_back(new WorkerCounters);
+	}
+	for (size_t i = 0; i < threads; i++)
+	{
+		threads_.emplace_back(&WorkerPool::run, this, i);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	wakeup_.notify_all();
+	for (auto &t : threads_)
+	{
+		t.join();
+	}
+
+	Completion *c = completions_.exchange(nullptr);
+	while (c)
+	{
+		Completion *next = c->next;
+		delete c;
+		c = next;
+	}
+}
+
+shared_ptr<Session> WorkerPool::openSession(chrono::steady_clock::time_point opened)
+{
+	auto session = make_shared<Session>(next_session_id_++, opened);
+	sessions_opened_.add();
+	lock_guard<mutex> lock(sessions_mutex_);
+	sessions_[session->id] = session;
+	return session;
+}
+
+void WorkerPool::closeSession(const shared_ptr<Session> &session)
+{
+	if (session->open.exchange(false))
+	{
+		sessions_closed_.add();
+		lock_guard<mutex> lock(sessions_mutex_);
+		sessions_.erase(session->id);
+	}
+}
+
+void WorkerPool::forEachSession(const function<void(const Session &)> &visit) const
+{
+	lock_guard<mutex> lock(sessions_mutex_);
+	for (const auto &entry : sessions_)
+	{
+		shared_ptr<Session> session = entry.second.lock();
+		if (session)
+		{
+			visit(*session);
+		}
+	}
+}
+
+namespace
+{
+	// Keeps Session::memory_bytes in step with a buffer that may have grown.
+	void trackGrowth(Session &session, size_t before, size_t after)
+	{
+		if (after != before)
+		{
+			session.memory_bytes.fetch_add((int64_t)after - (int64_t)before, memory_order_relaxed);
+		}
+	}
+}
+
+void WorkerPool::post(const shared_ptr<Session> &session, const char *data, size_t length,
+	chrono::steady_clock::time_point received, uint64_t sequence)
+{
+	TelemetryFrame *frame = session->spare_frames.pop();
+	if (!frame)
+	{
+		frame = new TelemetryFrame;
+		trackGrowth(*session, 0, sizeof(TelemetryFrame) + frame->data.capacity());
+	}
+	size_t capacity = frame->data.capacity();
+	frame->data.assign(data, length);
+	trackGrowth(*session, capacity, frame->data.capacity());
+	frame->received = received;
+	frame->sequence = sequence;
+
+	frames_received_.add();
+	TelemetryFrame *stale = session->mailbox.exchange(frame);
+	if (stale)
+	{
+		// The workers are behind; only the newest telemetry is worth planning.
+		frames_dropped_.add();
+		session->frames_dropped++;
+		session->spare_frames.push(stale);
+	}
+	if (!session->scheduled.exchange(true))
+	{
+		schedule(session);
+	}
+}
+
+void WorkerPool::schedule(const shared_ptr<Session> &session)
+{
+	{
+		lock_guard<mutex> lock(mutex_);
+		runnable_.push_back(session);
+	}
+	wakeup_.notify_one();
+}
+
+void WorkerPool::run(size_t index)
+{
+	WorkerCounters *counters = worker_counters_[index].get();
+	string name = "worker " + to_string(index);
+	setTraceThreadName(name.c_str());
+	setAllocationThreadName(name.c_str());
+	for (;;)
+	{
+		shared_ptr<Session> session;
+		{
+			unique_lock<mutex> lock(mutex_);
+			wakeup_.wait(lock, [this] { return stopping_ || !runnable_.empty(); });
+			if (stopping_)
+			{
+				return;
+			}
+			session = runnable_.front();
+			runnable_.pop_front();
+		}
+		process(session, *counters);
+	}
+}
+
+void WorkerPool::process(const shared_ptr<Session> &session, WorkerCounters &counters)
+{
+	for (;;)
+	{
+		TelemetryFrame *frame = session->mailbox.exchange(nullptr);
+		if (!frame)
+		{
+			session->scheduled.store(false);
+			// A frame may have been posted between the exchange and the store
+			// above; its poster saw 'scheduled' set and did not queue us.
+			if (!session->mailbox.load() || session->scheduled.exchange(true))
+			{
+				return;
+			}
+			continue;
+		}
+		if (!session->open.load())
+		{
+			session->spare_frames.push(frame);
+			continue;
+		}
+
+		uint64_t delay_us = chrono::duration_cast<chrono::microseconds>(
+			chrono::steady_clock::now() - frame->received).count();
+		counters.queue_delay_total_us.add(delay_us);
+		counters.queue_delay_max_us.raise(delay_us);
+
+		Completion *done = session->spare_completions.pop();
+		if (!done)
+		{
+			// More cycles in flight than ever before; size the buffer up
+			// front (with room to spare) rather than inside the handler.
+			done = new Completion;
+			done->message.reserve(2 * session->longest_message);
+			trackGrowth(*session, 0, sizeof(Completion) + done->message.capacity());
+		}
+		done->session = session;
+		done->sequence = frame->sequence;
+		done->next = nullptr;
+		bool planned = true;
+		size_t arena_capacity = session->arena.capacity();
+		size_t message_capacity = done->message.capacity();
+		AllocationCounts allocations = threadAllocationCounts();
+		try
+		{
+			TraceSessionScope trace_session(session->id, frame->sequence);
+			ScopedTraceEvent trace_cycle("cycle");
+			// Nothing from the previous cycle is alive any more.
+			session->arena.reset();
+			ArenaScope arena(session->arena);
+			handler_(*frame, *session, done->message);
+		}
+		catch (const exception &e)
+		{
+			cerr << "Planning cycle failed for session " << session->id << ": " << e.what() << endl;
+			planned = false;
+		}
+		session->spare_frames.push(frame);
+		AllocationCounts allocated = threadAllocationCounts();
+		session->allocations.add(allocated.allocations - allocations.allocations);
+		session->allocated_bytes.add(allocated.bytes_allocated - allocations.bytes_allocated);
+		trackGrowth(*session, arena_capacity, session->arena.capacity());
+		trackGrowth(*session, message_capacity, done->message.capacity());
+		if (!planned)
+		{
+			done->session.reset();
+			session->spare_completions.push(done);
+			continue;
+		}
+		counters.cycles_processed.add();
+		session->cycles++;
+		session->longest_message = max(session->longest_message, done->message.length());
+		session->lane.store(session->planner.lane, memory_order_relaxed);
+		session->speed.store(session->planner.current_car_speed, memory_order_relaxed);
+
+		done->next = completions_.load();
+		while (!completions_.compare_exchange_weak(done->next, done))
+		{
+		}
+		notify_();
+	}
+}
+
+void WorkerPool::drainCompletions(const function<void(Session &, const Completion &)> &send)
+{
+	// The stack hands completions back newest first; reverse to send in order.
+	Completion *c = completions_.exchange(nullptr);
+	Completion *ordered = nullptr;
+	while (c)
+	{
+		Completion *next = c->next;
+		c->next = ordered;
+		ordered = c;
+		c = next;
+	}
+	while (ordered)
+	{
+		Completion *next = ordered->next;
+		if (ordered->session->open.load() && !ordered->message.empty())
+		{
+			send(*ordered->session, *ordered);
+		}
+		// Hand the completion back to its session for reuse; it must not
+		// keep the session alive from there.
+		shared_ptr<Session> session = move(ordered->session);
+		session->spare_completions.push(ordered);
+		ordered = next;
+	}
+}
+
+PoolMetrics WorkerPool::metrics() const
+{
+	PoolMetrics m;
+	m.frames_received = frames_received_.load();
+	m.frames_dropped = frames_dropped_.load();
+	m.cycles_processed = 0;
+	m.queue_delay_total_us = 0;
+	m.queue_delay_max_us = 0;
+	for (const auto &counters : worker_counters_)
+	{
+		m.cycles_processed += counters->cycles_processed.load();
+		m.queue_delay_total_us += counters->queue_delay_total_us.load();
+		m.queue_delay_max_us = max(m.queue_delay_max_us, counters->queue_delay_max_us.load());
+	}
+	m.active_sessions = sessions_opened_.load() - sessions_closed_.load();
+	return m;
+}
@@ -0,0 +1,212 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+#include "counter.h"
+#include "planner.h"
+
+// An inbound event waiting to be planned.
+struct TelemetryFrame
+{
+	std::string data;  // JSON text of the event, as located by findData()
+	std::chrono::steady_clock::time_point received;
+	uint64_t sequence;  // per-session number of the inbound frame
+	TelemetryFrame *next;  // in a SpareList
+};
+
+struct Session;
+
+// Objects handed back for reuse. Any thread may push, but only one thread
+// at a time pops (the socket loop, or the worker holding the session), so
+// an item can't be popped and pushed again under a pop: no ABA.
+template <typename T>
+class SpareList
+{
+public:
+	SpareList() : head_(nullptr) {}
+	~SpareList()
+	{
+		T *item = head_.exchange(nullptr);
+		while (item)
+		{
+			T *next = item->next;
+			delete item;
+			item = next;
+		}
+	}
+	SpareList(const SpareList &) = delete;
+	SpareList &operator=(const SpareList &) = delete;
+
+	void push(T *item)
+	{
+		item->next = head_.load();
+		while (!head_.compare_exchange_weak(item->next, item))
+		{
+		}
+	}
+
+	T *pop()
+	{
+		T *item = head_.load();
+		while (item && !head_.compare_exchange_weak(item, item->next))
+		{
+		}
+		return item;
+	}
+
+private:
+	std::atomic<T *> head_;
+};
+
+// A control message ready to be sent, handed back to the socket loop.
+struct Completion
+{
+	std::shared_ptr<Session> session;
+	uint64_t sequence;  // of the frame this message answers
+	std::string message;
+	Completion *next;
+};
+
+// One simulator connection. The socket loop owns the connection itself and
+// only ever touches the mailbox; the planner state is only touched by the
+// worker that currently holds the session (see 'scheduled').
+struct Session
+{
+	Session(uint64_t id, std::chrono::steady_clock::time_point opened)
+		: id(id), planner(opened), cycles(0), longest_message(0), next_sequence(0), mailbox(nullptr), scheduled(false), open(true),
+		  frames_dropped(0), lane(planner.lane), speed(planner.current_car_speed),
+		  memory_bytes(sizeof(Session) + arena.capacity()) {}
+	~Session() { delete mailbox.exchange(nullptr); }
+
+	const uint64_t id;
+	PlannerState planner;
+	// Cycles planned so far, and the longest message they produced (new
+	// completions start with that capacity). Worker only.
+	uint64_t cycles;
+	size_t longest_message;
+	// Everything a cycle allocates transiently (the parsed telemetry and the
+	// control message JSON); reset at the start of every cycle.
+	Arena arena;
+	// Numbers inbound frames; socket loop only.
+	uint64_t next_sequence;
+
+	// Latest-wins slot: a newer frame replaces a stale one nobody picked up yet.
+	std::atomic<TelemetryFrame *> mailbox;
+	// True while the session sits in the run queue or a worker is planning it.
+	std::atomic<bool> scheduled;
+	std::atomic<bool> open;
+	std::atomic<uint64_t> frames_dropped;
+
+	// Copies of the planner state after the last cycle, safe to read from
+	// any thread (for the metrics page).
+	std::atomic<int> lane;
+	std::atomic<double> speed;
+
+	// Frames and completions handed back after use, so that their buffers
+	// are reused instead of allocated again for every frame. Frames are
+	// popped by the socket loop, completions by the worker.
+	SpareList<TelemetryFrame> spare_frames;
+	SpareList<Completion> spare_completions;
+
+	// Heap allocations of this session's cycles (worker only), and the
+	// memory it holds: itself, its arena and its frame and message buffers.
+	SingleWriterCounter allocations;
+	SingleWriterCounter allocated_bytes;
+	std::atomic<int64_t> memory_bytes;
+};
+
+// Snapshot of the pool counters.
+struct PoolMetrics
+{
+	uint64_t frames_received;
+	uint64_t frames_dropped;
+	uint64_t cycles_processed;
+	uint64_t queue_delay_total_us;
+	uint64_t queue_delay_max_us;
+	size_t active_sessions;
+};
+
+// Runs planning cycles off the socket loop. The loop posts frames into the
+// per-session mailboxes, workers plan them and push the resulting control
+// messages onto a lock-free completion stack; 'notify' is then called so the
+// loop can wake up and send them with drainCompletions().
+class WorkerPool
+{
+public:
+	// Writes the control message answering a frame into 'message' (which
+	// still holds an earlier one, to reuse its capacity); leaving it empty
+	// sends nothing. Runs inside an ArenaScope over the session's arena.
+	typedef std::function<void(const TelemetryFrame &, Session &, std::string &message)> Handler;
+
+	WorkerPool(size_t threads, Handler handler, std::function<void()> notify);
+	~WorkerPool();
+
+	std::shared_ptr<Session> openSession(std::chrono::steady_clock::time_point opened);
+	void closeSession(const std::shared_ptr<Session> &session);
+
+	// Called on the socket loop: queues the JSON text of an event for
+	// planning, copied into one of the session's earlier frames if it has
+	// one to spare.
+	void post(const std::shared_ptr<Session> &session, const char *data, size_t length,
+		std::chrono::steady_clock::time_point received, uint64_t sequence);
+
+	// Called on the socket loop; invokes 'send' for every finished cycle of a
+	// still open session that produced a message, in completion order.
+	void drainCompletions(const std::function<void(Session &, const Completion &)> &send);
+
+	PoolMetrics metrics() const;
+	void forEachSession(const std::function<void(const Session &)> &visit) const;
+
+private:
+	// Counters of one worker thread, padded so that workers don't share
+	// cache lines.
+	struct WorkerCounters
+	{
+		SingleWriterCounter cycles_processed;
+		SingleWriterCounter queue_delay_total_us;
+		SingleWriterCounter queue_delay_max_us;
+		char padding[64];
+	};
+
+	void run(size_t index);
+	void process(const std::shared_ptr<Session> &session, WorkerCounters &counters);
+	void schedule(const std::shared_ptr<Session> &session);
+
+	Handler handler_;
+	std::function<void()> notify_;
+	std::vector<std::thread> threads_;
+
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+	std::deque<std::shared_ptr<Session>> runnable_;
+	bool stopping_;
+
+	std::atomic<Completion *> completions_;
+
+	std::vector<std::unique_ptr<WorkerCounters>> worker_counters_;
+
+	// Open sessions by id; only locked when opening, closing or reporting.
+	mutable std::mutex sessions_mutex_;
+	std::unordered_map<uint64_t, std::weak_ptr<Session>> sessions_;
+
+	// Written on the socket loop only.
+	uint64_t next_session_id_;
+	SingleWriterCounter sessions_opened_;
+	SingleWriterCounter sessions_closed_;
+	SingleWriterCounter frames_received_;
+	SingleWriterCounter frames_dropped_;
+};
+
+#endif // WORKER_POOL_H